@@ -0,0 +1,126 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "hist-equ.h"
+#include <omp.h>
+
+// Executors. Every backend runs the same kernels and enhancement engines;
+// they differ only in how many processes and threads share an image:
+//
+//   serial   one process, one OpenMP thread
+//   openmp   one process, OMP_NUM_THREADS threads (the default)
+//   mpi      one part of the image per rank, see mpi-backend.cpp; only in
+//            binaries built with mpicxx -DHIST_MPI
+//   hybrid   mpi with OMP_NUM_THREADS threads per rank instead of one
+//
+// The executor is chosen once, by --backend NAME, before any image is read.
+
+// The kernels keep their parallel regions; a team of one runs them in order
+static void serial_init(int *, char ***)
+{
+    omp_set_dynamic(0);
+    omp_set_num_threads(1);
+}
+
+static const BACKEND serial_backend =
+{
+    "serial", 1, serial_init, NULL,
+    NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL
+};
+
+static const BACKEND openmp_backend =
+{
+    "openmp", 1, NULL, NULL,
+    NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL
+};
+
+static const BACKEND * backend = &openmp_backend;
+static int backend_rank_id = 0;
+static int backend_nprocs = 1;
+
+// Take --backend NAME out of the arguments and start that executor
+const BACKEND * backend_init(int * argc, char *** argv)
+{
+    const char * name = "openmp";
+    char ** args = *argv;
+    int i, n = 1;
+
+    for (i = 1; i < *argc; i++)
+    {
+        if (strcmp(args[i], "--backend") == 0 && i + 1 < *argc)
+            name = args[++i];
+        else
+            args[n++] = args[i];
+    }
+    args[n] = NULL;
+    *argc = n;
+
+    if (strcmp(name, "serial") == 0)
+        backend = &serial_backend;
+    else if (strcmp(name, "openmp") == 0)
+        backend = &openmp_backend;
+    else if (strcmp(name, "mpi") == 0 || strcmp(name, "hybrid") == 0)
+    {
+#ifdef HIST_MPI
+        backend = (strcmp(name, "mpi") == 0) ? &mpi_backend : &hybrid_backend;
+#else
+        printf("This binary was built without MPI, rebuild with mpicxx -DHIST_MPI!\n");
+        exit(1);
+#endif
+    }
+    else
+    {
+        printf("Unknown backend %s, use serial, openmp, mpi or hybrid!\n", name);
+        exit(1);
+    }
+
+    if (backend->init != NULL)
+        backend->init(argc, argv);
+    placement_init();
+    return backend;
+}
+
+const BACKEND * backend_current(void)
+{
+    return backend;
+}
+
+// Profile reports first, while the executor can still exchange them
+void backend_finalize(void)
+{
+    prof_report();
+    if (backend->finalize != NULL)
+        backend->finalize();
+}
+
+// Process of this executor that reads and writes the images
+int backend_rank(void)
+{
+    return backend_rank_id;
+}
+
+int backend_size(void)
+{
+    return backend_nprocs;
+}
+
+void backend_set_process(int rank, int size)
+{
+    backend_rank_id = rank;
+    backend_nprocs = size;
+}
+
+// Histogram and pixel count of the whole image, in 64 bits, from those of
+// this part
+void reduce_histogram(const int * hist, int nbr_bin, int part_size, long long * total, long long * img_size)
+{
+    int i;
+
+    for (i = 0; i < nbr_bin; i++)
+    {
+        total[i] = hist[i];
+    }
+    *img_size = part_size;
+    if (backend->reduce_histogram != NULL)
+        backend->reduce_histogram(total, nbr_bin, img_size);
+}
@@ -0,0 +1,344 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <dirent.h>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "hist-equ.h"
+#include <omp.h>
+
+// Pipelined batch mode. Reader threads load images, one enhancement thread
+// drives the threaded kernels over a nested team, and writer threads store
+// the results. The stages are connected by bounded queues, so reading image
+// N+1, enhancing image N and writing image N-1 overlap and throughput
+// approaches that of the slowest stage.
+
+typedef struct
+{
+    char in_path[PATH_MAX];
+    char out_path[PATH_MAX];
+    int is_color;
+    PGM_IMG gray;
+    PPM_IMG color;
+} BATCH_ITEM;
+
+typedef struct
+{
+    BATCH_ITEM ** slots;
+    int depth;
+    int head;
+    int count;
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+} BATCH_QUEUE;
+
+static void queue_init(BATCH_QUEUE * q, int depth)
+{
+    q->slots = (BATCH_ITEM **)malloc(depth * sizeof(BATCH_ITEM *));
+    q->depth = depth;
+    q->head = 0;
+    q->count = 0;
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->not_empty, NULL);
+    pthread_cond_init(&q->not_full, NULL);
+}
+
+static void queue_destroy(BATCH_QUEUE * q)
+{
+    pthread_mutex_destroy(&q->lock);
+    pthread_cond_destroy(&q->not_empty);
+    pthread_cond_destroy(&q->not_full);
+    free(q->slots);
+}
+
+// NULL is the end-of-stream marker
+static void queue_push(BATCH_QUEUE * q, BATCH_ITEM * item)
+{
+    pthread_mutex_lock(&q->lock);
+    while (q->count == q->depth)
+        pthread_cond_wait(&q->not_full, &q->lock);
+    q->slots[(q->head + q->count) % q->depth] = item;
+    q->count++;
+    pthread_cond_signal(&q->not_empty);
+    pthread_mutex_unlock(&q->lock);
+}
+
+static BATCH_ITEM * queue_pop(BATCH_QUEUE * q)
+{
+    BATCH_ITEM * item;
+
+    pthread_mutex_lock(&q->lock);
+    while (q->count == 0)
+        pthread_cond_wait(&q->not_empty, &q->lock);
+    item = q->slots[q->head];
+    q->head = (q->head + 1) % q->depth;
+    q->count--;
+    pthread_cond_signal(&q->not_full);
+    pthread_mutex_unlock(&q->lock);
+
+    return item;
+}
+
+static int has_suffix(const char * name, const char * suffix)
+{
+    size_t n = strlen(name), m = strlen(suffix);
+
+    return n > m && strcmp(name + n - m, suffix) == 0;
+}
+
+static int compare_names(const void * a, const void * b)
+{
+    return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+static void add_input(char *** list, int * count, int * cap, const char * path)
+{
+    if (*count == *cap)
+    {
+        *cap = (*cap == 0) ? 64 : *cap * 2;
+        *list = (char **)realloc(*list, *cap * sizeof(char *));
+    }
+    (*list)[(*count)++] = strdup(path);
+}
+
+// Expand directories to their .ppm/.pgm files and "@list" files to one path
+// per line; anything else is taken as an image path
+char ** collect_inputs(char ** args, int nargs, int * count)
+{
+    char ** list = NULL;
+    char path[PATH_MAX];
+    int cap = 0, i, first;
+    struct stat st;
+
+    *count = 0;
+    for (i = 0; i < nargs; i++)
+    {
+        if (args[i][0] == '@')
+        {
+            FILE * f = fopen(args[i] + 1, "r");
+
+            if (f == NULL)
+            {
+                printf("Cannot open list %s!\n", args[i] + 1);
+                exit(1);
+            }
+            while (fgets(path, sizeof(path), f) != NULL)
+            {
+                path[strcspn(path, "\r\n")] = '\0';
+                if (path[0] != '\0')
+                    add_input(&list, count, &cap, path);
+            }
+            fclose(f);
+        }
+        else if (stat(args[i], &st) == 0 && S_ISDIR(st.st_mode))
+        {
+            DIR * dir = opendir(args[i]);
+            struct dirent * ent;
+
+            first = *count;
+            while (dir != NULL && (ent = readdir(dir)) != NULL)
+            {
+                if (has_suffix(ent->d_name, ".ppm") || has_suffix(ent->d_name, ".pgm"))
+                {
+                    snprintf(path, sizeof(path), "%s/%s", args[i], ent->d_name);
+                    add_input(&list, count, &cap, path);
+                }
+            }
+            if (dir != NULL)
+                closedir(dir);
+            qsort(list + first, *count - first, sizeof(char *), compare_names);
+        }
+        else
+        {
+            add_input(&list, count, &cap, args[i]);
+        }
+    }
+
+    return list;
+}
+
+// Outputs are named after the basename of their input, so two inputs with
+// the same basename would overwrite each other's output; reject them and
+// create out_dir
+void prepare_outputs(const char * out_dir, char ** files, int nfiles)
+{
+    const char ** names = (const char **)malloc(nfiles * sizeof(char *));
+    struct stat st;
+    int i;
+
+    for (i = 0; i < nfiles; i++)
+    {
+        names[i] = strrchr(files[i], '/') ? strrchr(files[i], '/') + 1 : files[i];
+    }
+    qsort(names, nfiles, sizeof(char *), compare_names);
+    for (i = 1; i < nfiles; i++)
+    {
+        if (strcmp(names[i - 1], names[i]) == 0)
+        {
+            printf("Two inputs are named %s, their outputs would overwrite each other!\n", names[i]);
+            exit(1);
+        }
+    }
+    free(names);
+
+    if (mkdir(out_dir, 0755) != 0 &&
+        (errno != EEXIST || stat(out_dir, &st) != 0 || !S_ISDIR(st.st_mode)))
+    {
+        printf("Cannot create output directory %s!\n", out_dir);
+        exit(1);
+    }
+}
+
+void batch_contrast_enhancement(char ** inputs, int ninputs, const BATCH_OPTIONS * opt)
+{
+    BATCH_QUEUE to_enhance, to_write;
+    char ** files;
+    int nfiles, next = 0, readers_left, done = 0, i;
+    double start, stage_time[3] = {0, 0, 0};
+
+    files = collect_inputs(inputs, ninputs, &nfiles);
+    if (nfiles == 0)
+    {
+        printf("No input images!\n");
+        return;
+    }
+    prepare_outputs(opt->out_dir, files, nfiles);
+
+    queue_init(&to_enhance, opt->depth);
+    queue_init(&to_write, opt->depth);
+    readers_left = opt->readers;
+
+    printf("Batch of %d images: %d reader(s), %d enhancement thread(s), %d writer(s), queue depth %d\n",
+           nfiles, opt->readers, opt->workers, opt->writers, opt->depth);
+
+    omp_set_max_active_levels(2);
+    start = omp_get_wtime();
+
+    #pragma omp parallel num_threads(opt->readers + 1 + opt->writers)
+    {
+        int id = omp_get_thread_num();
+        double busy = 0, t;
+        BATCH_ITEM * item;
+
+        // Stages are not the default team; with HIST_PIN let them and the
+        // enhancement team run anywhere
+        placement_unpin();
+
+        if (id < opt->readers)
+        {
+            /* Read stage */
+            omp_set_num_threads(1);
+            for (;;)
+            {
+                int k;
+
+                #pragma omp atomic capture
+                k = next++;
+                if (k >= nfiles)
+                    break;
+
+                t = omp_get_wtime();
+                item = (BATCH_ITEM *)calloc(1, sizeof(BATCH_ITEM));
+                snprintf(item->in_path, sizeof(item->in_path), "%s", files[k]);
+                snprintf(item->out_path, sizeof(item->out_path), "%s/%s", opt->out_dir,
+                         strrchr(files[k], '/') ? strrchr(files[k], '/') + 1 : files[k]);
+                item->is_color = has_suffix(files[k], ".ppm");
+                if (item->is_color)
+                    item->color = read_ppm(item->in_path);
+                else
+                    item->gray = read_pgm(item->in_path);
+                busy += omp_get_wtime() - t;
+
+                queue_push(&to_enhance, item);
+            }
+
+            #pragma omp atomic update
+            stage_time[0] += busy;
+
+            int last;
+            #pragma omp atomic capture
+            last = --readers_left;
+            if (last == 0)
+                queue_push(&to_enhance, NULL);
+        }
+        else if (id == opt->readers)
+        {
+            /* Enhancement stage, kernels run on a nested team */
+            omp_set_num_threads(opt->workers);
+            while ((item = queue_pop(&to_enhance)) != NULL)
+            {
+                t = omp_get_wtime();
+                if (item->is_color)
+                {
+                    PPM_IMG out;
+
+                    if (opt->mode == STREAM_HSL)
+                        out = contrast_enhancement_c_hsl(item->color);
+                    else if (opt->mode == STREAM_RGB)
+                        out = contrast_enhancement_c_rgb(item->color);
+                    else
+                        out = contrast_enhancement_c_yuv(item->color);
+                    free_ppm(item->color);
+                    item->color = out;
+                }
+                else
+                {
+                    PGM_IMG out = contrast_enhancement_g(item->gray);
+
+                    free_pgm(item->gray);
+                    item->gray = out;
+                }
+                busy += omp_get_wtime() - t;
+
+                queue_push(&to_write, item);
+            }
+            stage_time[1] = busy;
+
+            for (int w = 0; w < opt->writers; w++)
+                queue_push(&to_write, NULL);
+        }
+        else
+        {
+            /* Write stage */
+            omp_set_num_threads(1);
+            while ((item = queue_pop(&to_write)) != NULL)
+            {
+                t = omp_get_wtime();
+                if (item->is_color)
+                {
+                    write_ppm(item->color, item->out_path);
+                    free_ppm(item->color);
+                }
+                else
+                {
+                    write_pgm(item->gray, item->out_path);
+                    free_pgm(item->gray);
+                }
+                free(item);
+                busy += omp_get_wtime() - t;
+
+                #pragma omp atomic update
+                done++;
+            }
+
+            #pragma omp atomic update
+            stage_time[2] += busy;
+        }
+    }
+
+    start = omp_get_wtime() - start;
+    printf("Batch processing time: %lf (ms), %.2f images/s\n", start * 1000.0, done / start);
+    printf("Stage busy time: read %lf (ms, %d threads), enhance %lf (ms), write %lf (ms, %d threads)\n",
+           stage_time[0] * 1000.0, opt->readers, stage_time[1] * 1000.0,
+           stage_time[2] * 1000.0, opt->writers);
+
+    queue_destroy(&to_enhance);
+    queue_destroy(&to_write);
+    arena_trim();
+    for (i = 0; i < nfiles; i++)
+        free(files[i]);
+    free(files);
+}
@@ -0,0 +1,401 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include "hist-equ.h"
+#include <omp.h>
+
+// Microbenchmarks of the individual kernels on synthetic images.
+//
+// g++ -O2 -fopenmp -o benchmark benchmark.cpp contrast-enhancement.cpp ... (see README)
+// ./benchmark [--sizes 1,4,16,64] [--dists uniform,flat,narrow,natural]
+//             [--kernels name,...] [--reps N] [--tmp DIR]
+// ./benchmark --emit DIR [--sizes MP] [--dists name]
+//
+// Sizes are in megapixels (1 MP = 1024 x 1024). Each kernel runs once to warm
+// up and then --reps times; the table reports mean, standard deviation and
+// minimum time, and throughput in MPix/s and GB/s at the mean time. GB/s
+// counts the bytes each kernel reads and writes once.
+//
+// --emit writes the synthetic in.pgm and in.ppm of the first size and
+// distribution (default natural) to DIR instead, as input for other runs.
+
+typedef enum
+{
+    DIST_UNIFORM,          // every value equally likely
+    DIST_FLAT,             // a single value
+    DIST_NARROW,           // values in a 16-level band
+    DIST_NATURAL           // smooth gradients and edges plus noise
+} DIST;
+
+static const char * dist_names[] = {"uniform", "flat", "narrow", "natural"};
+
+typedef struct
+{
+    int w;
+    int h;
+    PGM_IMG gray;
+    PPM_IMG color;
+    YUV_IMG yuv;
+    HSL_IMG hsl;
+    unsigned char * out;   // scratch plane for the LUT apply
+    int hist[256];
+    const char * tmp_dir;
+} BENCH_INPUT;
+
+typedef void (*BENCH_FN)(BENCH_INPUT * in);
+
+typedef struct
+{
+    const char * name;
+    BENCH_FN run;
+    double bytes_per_pixel;
+} BENCH_KERNEL;
+
+static unsigned int xorshift(unsigned int * s)
+{
+    *s ^= *s << 13;
+    *s ^= *s >> 17;
+    *s ^= *s << 5;
+    return *s;
+}
+
+// Pixel value at (x, y) of channel c for the given distribution
+static unsigned char synth_pixel(DIST dist, int x, int y, int w, int h, int c, unsigned int * seed)
+{
+    switch (dist)
+    {
+    case DIST_UNIFORM:
+        return (unsigned char)(xorshift(seed) >> 24);
+    case DIST_FLAT:
+        return 128;
+    case DIST_NARROW:
+        return (unsigned char)(96 + (xorshift(seed) >> 28));
+    default:
+    {
+        // Low-contrast scene: two gradients, a disc and a little noise
+        float fx = (float)x / w, fy = (float)y / h;
+        float v = 60 + 40 * fx + 30 * sinf(6.0f * fy + c) + 20 * cosf(9.0f * fx * fy);
+        float dx = fx - 0.6f, dy = fy - 0.4f;
+
+        if (dx * dx + dy * dy < 0.04f)
+            v += 35 - 10 * c;
+        v += (float)(xorshift(seed) >> 28) - 8;
+        return (unsigned char)(v < 0 ? 0 : (v > 255 ? 255 : v));
+    }
+    }
+}
+
+static void synth_image(BENCH_INPUT * in, DIST dist, int w, int h)
+{
+    long n = (long)w * h;
+    long i;
+
+    in->w = w;
+    in->h = h;
+    in->gray.w = in->color.w = w;
+    in->gray.h = in->color.h = h;
+    in->gray.img = (unsigned char *)arena_alloc(n);
+    in->color.img_r = (unsigned char *)arena_alloc(n);
+    in->color.img_g = (unsigned char *)arena_alloc(n);
+    in->color.img_b = (unsigned char *)arena_alloc(n);
+    in->out = (unsigned char *)arena_alloc(n);
+
+    #pragma omp parallel
+    {
+        unsigned int seed = 2463534242u + 7919u * omp_get_thread_num();
+
+        #pragma omp for schedule(static)
+            for (i = 0; i < n; i++)
+            {
+                int x = (int)(i % w), y = (int)(i / w);
+
+                in->gray.img[i] = synth_pixel(dist, x, y, w, h, 0, &seed);
+                in->color.img_r[i] = synth_pixel(dist, x, y, w, h, 0, &seed);
+                in->color.img_g[i] = synth_pixel(dist, x, y, w, h, 1, &seed);
+                in->color.img_b[i] = synth_pixel(dist, x, y, w, h, 2, &seed);
+                in->out[i] = 0;
+            }
+    }
+
+    // Inputs of the inverse conversions and of the LUT apply
+    in->yuv = rgb2yuv(in->color);
+    in->hsl = rgb2hsl(in->color);
+    histogram(in->hist, in->gray.img, (int)n, 256);
+}
+
+static void free_input(BENCH_INPUT * in)
+{
+    arena_free(in->gray.img);
+    free_ppm(in->color);
+    arena_free(in->out);
+    arena_free(in->yuv.img_y);
+    arena_free(in->yuv.img_u);
+    arena_free(in->yuv.img_v);
+    arena_free(in->hsl.h);
+    arena_free(in->hsl.s);
+    arena_free(in->hsl.l);
+}
+
+static void bench_histogram(BENCH_INPUT * in)
+{
+    int hist[256];
+
+    histogram(hist, in->gray.img, in->w * in->h, 256);
+}
+
+static void bench_lut_apply(BENCH_INPUT * in)
+{
+    histogram_equalization(in->out, in->gray.img, in->hist, in->w * in->h, 256);
+}
+
+static void bench_rgb2yuv(BENCH_INPUT * in)
+{
+    YUV_IMG yuv = rgb2yuv(in->color);
+
+    arena_free(yuv.img_y);
+    arena_free(yuv.img_u);
+    arena_free(yuv.img_v);
+}
+
+static void bench_yuv2rgb(BENCH_INPUT * in)
+{
+    free_ppm(yuv2rgb(in->yuv));
+}
+
+static void bench_rgb2hsl(BENCH_INPUT * in)
+{
+    HSL_IMG hsl = rgb2hsl(in->color);
+
+    arena_free(hsl.h);
+    arena_free(hsl.s);
+    arena_free(hsl.l);
+}
+
+static void bench_hsl2rgb(BENCH_INPUT * in)
+{
+    free_ppm(hsl2rgb(in->hsl));
+}
+
+static void bench_write_pgm(BENCH_INPUT * in)
+{
+    char path[4096];
+
+    snprintf(path, sizeof(path), "%s/bench.pgm", in->tmp_dir);
+    write_pgm(in->gray, path);
+}
+
+static void bench_read_pgm(BENCH_INPUT * in)
+{
+    char path[4096];
+
+    snprintf(path, sizeof(path), "%s/bench.pgm", in->tmp_dir);
+    free_pgm(read_pgm(path));
+}
+
+static void bench_write_ppm(BENCH_INPUT * in)
+{
+    char path[4096];
+
+    snprintf(path, sizeof(path), "%s/bench.ppm", in->tmp_dir);
+    write_ppm(in->color, path);
+}
+
+static void bench_read_ppm(BENCH_INPUT * in)
+{
+    char path[4096];
+
+    snprintf(path, sizeof(path), "%s/bench.ppm", in->tmp_dir);
+    free_ppm(read_ppm(path));
+}
+
+static void bench_enhance_g(BENCH_INPUT * in)
+{
+    free_pgm(contrast_enhancement_g(in->gray));
+}
+
+static void bench_enhance_yuv(BENCH_INPUT * in)
+{
+    free_ppm(contrast_enhancement_c_yuv(in->color));
+}
+
+static void bench_enhance_hsl(BENCH_INPUT * in)
+{
+    free_ppm(contrast_enhancement_c_hsl(in->color));
+}
+
+// Bytes read plus bytes written per pixel
+static const BENCH_KERNEL kernels[] =
+{
+    {"histogram",     bench_histogram,   1},
+    {"lut_apply",     bench_lut_apply,   2},
+    {"rgb2yuv",       bench_rgb2yuv,     6},
+    {"yuv2rgb",       bench_yuv2rgb,     6},
+    {"rgb2hsl",       bench_rgb2hsl,     12},
+    {"hsl2rgb",       bench_hsl2rgb,     12},
+    {"write_pgm",     bench_write_pgm,   2},
+    {"read_pgm",      bench_read_pgm,    2},
+    {"write_ppm",     bench_write_ppm,   6},
+    {"read_ppm",      bench_read_ppm,    6},
+    {"enhance_gray",  bench_enhance_g,   2},
+    {"enhance_yuv",   bench_enhance_yuv, 6},
+    {"enhance_hsl",   bench_enhance_hsl, 6},
+};
+
+// Is name in the comma-separated list (NULL selects everything)?
+static int selected(const char * list, const char * name)
+{
+    size_t n = strlen(name);
+    const char * p = list;
+
+    if (list == NULL)
+        return 1;
+    while ((p = strstr(p, name)) != NULL)
+    {
+        if ((p == list || p[-1] == ',') && (p[n] == ',' || p[n] == '\0'))
+            return 1;
+        p += n;
+    }
+    return 0;
+}
+
+static void run_kernel(const BENCH_KERNEL * k, BENCH_INPUT * in, DIST dist, double mp, int reps)
+{
+    double sum = 0, sum2 = 0, best = 1e30, mean, sd, t;
+    double pixels = (double)in->w * in->h;
+    int r;
+
+    k->run(in);    // warm-up
+
+    for (r = 0; r < reps; r++)
+    {
+        t = omp_get_wtime();
+        k->run(in);
+        t = omp_get_wtime() - t;
+
+        sum += t;
+        sum2 += t * t;
+        if (t < best)
+            best = t;
+    }
+
+    mean = sum / reps;
+    sd = (reps > 1) ? sqrt((sum2 - sum * sum / reps) / (reps - 1)) : 0;
+    if (sd != sd)
+        sd = 0;
+
+    printf("%-13s %-8s %8.1f %5d %11.3f %10.3f %11.3f %10.1f %8.2f\n",
+           k->name, dist_names[dist], mp, reps, mean * 1e3, sd * 1e3, best * 1e3,
+           pixels / mean / 1e6, pixels * k->bytes_per_pixel / mean / 1e9);
+}
+
+// Write in.pgm and in.ppm of the first size and distribution to dir
+static int emit_images(const char * dir, const char * sizes, const char * dists)
+{
+    BENCH_INPUT in;
+    char path[4096];
+    double mp = atof(sizes);
+    int w = (int)(sqrt(mp) * 1024);
+    int h = (w > 0) ? (int)(mp * 1048576.0 / w) : 0;
+    int d;
+
+    for (d = DIST_UNIFORM; d < DIST_NATURAL && !selected(dists, dist_names[d]); d++)
+        ;
+    if (w < 1 || h < 1 || !selected(dists, dist_names[d]))
+    {
+        printf("Nothing to emit for size %s and distribution %s!\n", sizes, dists);
+        return 1;
+    }
+
+    synth_image(&in, (DIST)d, w, h);
+    snprintf(path, sizeof(path), "%s/in.pgm", dir);
+    write_pgm(in.gray, path);
+    snprintf(path, sizeof(path), "%s/in.ppm", dir);
+    write_ppm(in.color, path);
+    printf("Wrote %d x %d %s images to %s\n", w, h, dist_names[d], dir);
+    free_input(&in);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    const char * sizes = NULL;
+    const char * dists = NULL;
+    const char * names = NULL;
+    const char * emit_dir = NULL;
+    const char * p;
+    BENCH_INPUT in;
+    int reps = 10, i, d, nthreads;
+
+    in.tmp_dir = "/tmp";
+    for (i = 1; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "--sizes") == 0)
+            sizes = argv[i + 1];
+        else if (strcmp(argv[i], "--dists") == 0)
+            dists = argv[i + 1];
+        else if (strcmp(argv[i], "--kernels") == 0)
+            names = argv[i + 1];
+        else if (strcmp(argv[i], "--reps") == 0)
+            reps = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--tmp") == 0)
+            in.tmp_dir = argv[i + 1];
+        else if (strcmp(argv[i], "--emit") == 0)
+            emit_dir = argv[i + 1];
+        else
+        {
+            printf("Unknown option %s!\n", argv[i]);
+            exit(1);
+        }
+    }
+    if (i < argc || reps < 1)
+    {
+        printf("Usage: %s [--sizes MP,...] [--dists name,...] [--kernels name,...] [--reps N] [--tmp DIR]\n", argv[0]);
+        printf("       %s --emit DIR [--sizes MP] [--dists name]\n", argv[0]);
+        exit(1);
+    }
+
+    if (emit_dir != NULL)
+        return emit_images(emit_dir, (sizes == NULL) ? "1" : sizes, (dists == NULL) ? "natural" : dists);
+    if (sizes == NULL)
+        sizes = "1,4,16,64";
+
+    nthreads = omp_get_max_threads();
+    printf("Kernel benchmark with %d threads; histogram %s, LUT %s, color %s\n",
+           nthreads, histogram_kernel_name(), lut_apply_kernel_name(), color_kernel_name());
+    printf("%-13s %-8s %8s %5s %11s %10s %11s %10s %8s\n",
+           "kernel", "dist", "MP", "reps", "mean(ms)", "sd(ms)", "min(ms)", "MPix/s", "GB/s");
+
+    for (p = sizes; p != NULL && *p != '\0'; p = strchr(p, ',') ? strchr(p, ',') + 1 : NULL)
+    {
+        double mp = atof(p);
+        int w = (int)(sqrt(mp) * 1024);
+        int h = (int)(mp * 1048576.0 / w);
+
+        if (w < 1 || h < 1)
+            continue;
+
+        for (d = DIST_UNIFORM; d <= DIST_NATURAL; d++)
+        {
+            unsigned int k;
+
+            if (!selected(dists, dist_names[d]))
+                continue;
+
+            synth_image(&in, (DIST)d, w, h);
+            if (selected(names, "read_pgm"))
+                bench_write_pgm(&in);
+            if (selected(names, "read_ppm"))
+                bench_write_ppm(&in);
+            for (k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++)
+            {
+                if (selected(names, kernels[k].name))
+                    run_kernel(&kernels[k], &in, (DIST)d, mp, reps);
+            }
+            free_input(&in);
+            arena_trim();
+        }
+    }
+
+    return 0;
+}
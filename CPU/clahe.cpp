@@ -0,0 +1,255 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "hist-equ.h"
+#include <omp.h>
+
+// Contrast-limited adaptive histogram equalization. The image is split into
+// a grid of tiles; every tile gets its own clipped histogram and LUT, built
+// in parallel with the same histogram and LUT code as the global path, and
+// each pixel is mapped through the bilinear blend of the LUTs of the four
+// nearest tile centres. Gray images are equalized directly, color images on
+// Y (YUV) or L (HSL).
+
+// Pixels converted per block for the color paths
+#define CLAHE_BLOCK 4096
+
+// Clip the histogram of npix pixels at clip_limit times the mean bin count
+// and spread the excess evenly over all bins
+static void clip_histogram(int * hist, int npix, float clip_limit)
+{
+    int limit, excess = 0, add, rem, step, i;
+
+    if (clip_limit <= 0)
+        return;
+
+    limit = (int)(clip_limit * npix / 256);
+    if (limit < 1)
+        limit = 1;
+
+    for (i = 0; i < 256; i++)
+    {
+        if (hist[i] > limit)
+        {
+            excess += hist[i] - limit;
+            hist[i] = limit;
+        }
+    }
+
+    add = excess / 256;
+    rem = excess % 256;
+    for (i = 0; i < 256; i++)
+    {
+        hist[i] += add;
+    }
+    if (rem > 0)
+    {
+        step = 256 / rem;
+        for (i = 0; i < 256 && rem > 0; i += step, rem--)
+        {
+            hist[i]++;
+        }
+    }
+}
+
+// LUT of the tile with top-left corner (x0, y0) and size tw x th
+static void tile_lut(unsigned char * lut, const unsigned char * in, int w,
+                     int x0, int y0, int tw, int th, float clip_limit)
+{
+    unsigned int counts[256] = {0};
+    int hist[256];
+    int npix = tw * th, y, i;
+
+    for (y = y0; y < y0 + th; y++)
+    {
+        histogram_kernel(counts, in + (long)y * w + x0, tw);
+    }
+
+    for (i = 0; i < 256; i++)
+    {
+        hist[i] = (int)counts[i];
+    }
+
+    // A flat tile has nothing to stretch
+    for (i = 0; i < 256 && hist[i] == 0; i++)
+        ;
+    if (hist[i] == npix)
+    {
+        for (i = 0; i < 256; i++)
+        {
+            lut[i] = (unsigned char)i;
+        }
+        return;
+    }
+
+    clip_histogram(hist, npix, clip_limit);
+    histogram_lut_u8(lut, hist, npix, 256);
+}
+
+// Neighbouring tiles of coordinate i along an axis split into tiles of size
+// t, and the weight (0..256) of the second one
+static inline void tile_weight(int i, int t, int ntiles, int * t0, int * t1, int * wt)
+{
+    // Position relative to the tile centres, in 1/256 of a tile
+    int f = ((2 * i + 1) * 128) / t - 128;
+    int k = f >> 8;
+
+    if (f < 0)
+    {
+        *t0 = *t1 = 0;
+        *wt = 0;
+    }
+    else if (k >= ntiles - 1)
+    {
+        *t0 = *t1 = ntiles - 1;
+        *wt = 0;
+    }
+    else
+    {
+        *t0 = k;
+        *t1 = k + 1;
+        *wt = f & 255;
+    }
+}
+
+// CLAHE of one w x h plane; img_out may be img_in
+void clahe_plane(unsigned char * img_out, const unsigned char * img_in, int w, int h,
+                 const CLAHE_PARAMS * par)
+{
+    int tiles_x = (par->tiles_x < 1) ? 1 : (par->tiles_x > w ? w : par->tiles_x);
+    int tiles_y = (par->tiles_y < 1) ? 1 : (par->tiles_y > h ? h : par->tiles_y);
+    int tile_w = (w + tiles_x - 1) / tiles_x;
+    int tile_h = (h + tiles_y - 1) / tiles_y;
+    unsigned char * luts;
+    int * cols;
+    int t;
+
+    // Round the grid down so no tile is empty
+    tiles_x = (w + tile_w - 1) / tile_w;
+    tiles_y = (h + tile_h - 1) / tile_h;
+
+    luts = (unsigned char *)arena_alloc((size_t)tiles_x * tiles_y * 256);
+    cols = (int *)arena_alloc((size_t)3 * w * sizeof(int));
+
+    /* Tile LUTs, independent of each other */
+    #pragma omp parallel for schedule(dynamic)
+        for (t = 0; t < tiles_x * tiles_y; t++)
+        {
+            int tx = t % tiles_x, ty = t / tiles_x;
+            int x0 = tx * tile_w, y0 = ty * tile_h;
+            int tw = (w - x0 < tile_w) ? w - x0 : tile_w;
+            int th = (h - y0 < tile_h) ? h - y0 : tile_h;
+
+            tile_lut(luts + (long)t * 256, img_in, w, x0, y0, tw, th, par->clip_limit);
+        }
+
+    for (t = 0; t < w; t++)
+    {
+        tile_weight(t, tile_w, tiles_x, &cols[t], &cols[w + t], &cols[2 * w + t]);
+    }
+
+    /* Bilinear blend of the four surrounding tile LUTs, every thread over
+       its thread_range slice of the plane, row piece by row piece */
+    #pragma omp parallel
+    {
+        long start, end, k;
+        thread_range((long)w * h, omp_get_thread_num(), omp_get_num_threads(), &start, &end);
+
+        for (k = start; k < end; )
+        {
+            int y = (int)(k / w);
+            int x0 = (int)(k - (long)y * w);
+            int x1 = (end - k < w - x0) ? x0 + (int)(end - k) : w;
+            int ty0, ty1, wy, x;
+            const unsigned char * row_in = img_in + (long)y * w;
+            unsigned char * row_out = img_out + (long)y * w;
+            const unsigned char * lut0;
+            const unsigned char * lut1;
+
+            tile_weight(y, tile_h, tiles_y, &ty0, &ty1, &wy);
+            lut0 = luts + (long)ty0 * tiles_x * 256;
+            lut1 = luts + (long)ty1 * tiles_x * 256;
+
+            for (x = x0; x < x1; x++)
+            {
+                int v = row_in[x];
+                int a0 = cols[x] * 256, a1 = cols[w + x] * 256, wx = cols[2 * w + x];
+                int top = lut0[a0 + v] * (256 - wx) + lut0[a1 + v] * wx;
+                int bottom = lut1[a0 + v] * (256 - wx) + lut1[a1 + v] * wx;
+
+                row_out[x] = (unsigned char)((top * (256 - wy) + bottom * wy + 32768) >> 16);
+            }
+            k += x1 - x0;
+        }
+    }
+
+    arena_free(cols);
+    arena_free(luts);
+}
+
+PGM_IMG clahe_g(PGM_IMG img_in, const CLAHE_PARAMS * par)
+{
+    PGM_IMG result;
+
+    result.w = img_in.w;
+    result.h = img_in.h;
+    result.img = (unsigned char *)arena_alloc(result.w * result.h * sizeof(unsigned char));
+
+    clahe_plane(result.img, img_in.img, img_in.w, img_in.h, par);
+    return result;
+}
+
+// CLAHE on Y (STREAM_YUV) or L (STREAM_HSL) of a color image
+PPM_IMG clahe_c(PPM_IMG img_in, STREAM_MODE mode, const CLAHE_PARAMS * par)
+{
+    PPM_IMG result;
+    unsigned char * x;
+    int img_size;
+
+    img_size = img_in.w * img_in.h;
+    result.w = img_in.w;
+    result.h = img_in.h;
+    result.img_r = (unsigned char *)arena_alloc(result.w * result.h * sizeof(unsigned char));
+    result.img_g = (unsigned char *)arena_alloc(result.w * result.h * sizeof(unsigned char));
+    result.img_b = (unsigned char *)arena_alloc(result.w * result.h * sizeof(unsigned char));
+    x = (unsigned char *)arena_alloc(img_size * sizeof(unsigned char));
+
+    #pragma omp parallel
+    {
+        long start, end, i;
+        thread_range(img_size, omp_get_thread_num(), omp_get_num_threads(), &start, &end);
+
+        for (i = start; i < end; i += CLAHE_BLOCK)
+        {
+            int n = (end - i < CLAHE_BLOCK) ? (int)(end - i) : CLAHE_BLOCK;
+
+            if (mode == STREAM_HSL)
+                lightness_block(x + i, img_in.img_r + i, img_in.img_g + i, img_in.img_b + i, n);
+            else
+                luma_block(x + i, img_in.img_r + i, img_in.img_g + i, img_in.img_b + i, n);
+        }
+    }
+
+    clahe_plane(x, x, img_in.w, img_in.h, par);
+
+    #pragma omp parallel
+    {
+        long start, end, i;
+        thread_range(img_size, omp_get_thread_num(), omp_get_num_threads(), &start, &end);
+
+        for (i = start; i < end; i += CLAHE_BLOCK)
+        {
+            int n = (end - i < CLAHE_BLOCK) ? (int)(end - i) : CLAHE_BLOCK;
+
+            if (mode == STREAM_HSL)
+                hsl_replace_block(result.img_r + i, result.img_g + i, result.img_b + i,
+                                  img_in.img_r + i, img_in.img_g + i, img_in.img_b + i, x + i, n);
+            else
+                yuv_replace_block(result.img_r + i, result.img_g + i, result.img_b + i,
+                                  img_in.img_r + i, img_in.img_g + i, img_in.img_b + i, x + i, n);
+        }
+    }
+
+    arena_free(x);
+    return result;
+}
@@ -0,0 +1,607 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "hist-equ.h"
+#include <omp.h>
+
+// Pixels converted per block by the fused paths; the block stays in L1 so
+// the converted channels never reach memory.
+#define HIST_BLOCK 4096
+
+static inline unsigned char rgb2l_pixel(unsigned char r, unsigned char g, unsigned char b);
+static inline void rgb2hsl_pixel(unsigned char r, unsigned char g, unsigned char b,
+                                 float * h, float * s, unsigned char * l);
+static inline void hsl2rgb_pixel(float H, float S, unsigned char l,
+                                 unsigned char * r, unsigned char * g, unsigned char * b);
+
+PGM_IMG contrast_enhancement_g(PGM_IMG img_in)
+{
+    PGM_IMG result;
+    int hist[256];
+    
+    result.w = img_in.w;
+    result.h = img_in.h;
+    result.img = (unsigned char *)arena_alloc(result.w * result.h * sizeof(unsigned char));
+    
+    histogram(hist, img_in.img, img_in.h * img_in.w, 256);
+    histogram_equalization(result.img,img_in.img,hist,result.w*result.h, 256);
+    return result;
+}
+
+PPM_IMG contrast_enhancement_c_rgb(PPM_IMG img_in)
+{
+    PPM_IMG result;
+    int hist[256];
+    
+    result.w = img_in.w;
+    result.h = img_in.h;
+    result.img_r = (unsigned char *)arena_alloc(result.w * result.h * sizeof(unsigned char));
+    result.img_g = (unsigned char *)arena_alloc(result.w * result.h * sizeof(unsigned char));
+    result.img_b = (unsigned char *)arena_alloc(result.w * result.h * sizeof(unsigned char));
+    
+    histogram(hist, img_in.img_r, img_in.h * img_in.w, 256);
+    histogram_equalization(result.img_r,img_in.img_r,hist,result.w*result.h, 256);
+    histogram(hist, img_in.img_g, img_in.h * img_in.w, 256);
+    histogram_equalization(result.img_g,img_in.img_g,hist,result.w*result.h, 256);
+    histogram(hist, img_in.img_b, img_in.h * img_in.w, 256);
+    histogram_equalization(result.img_b,img_in.img_b,hist,result.w*result.h, 256);
+
+    return result;
+}
+
+//16-bit contrast enhancement, maxval + 1 bins
+PGM16_IMG contrast_enhancement_g16(PGM16_IMG img_in)
+{
+    PGM16_IMG result;
+    int img_size = img_in.w * img_in.h;
+    int nbr_bin = img_in.v_max + 1;
+    int * hist = (int *)arena_alloc(nbr_bin * sizeof(int));
+
+    result.w = img_in.w;
+    result.h = img_in.h;
+    result.v_max = img_in.v_max;
+    result.img = (unsigned short *)arena_alloc(img_size * sizeof(unsigned short));
+
+    histogram16(hist, img_in.img, img_size, nbr_bin);
+    histogram_equalization16(result.img, img_in.img, hist, img_size, nbr_bin);
+
+    arena_free(hist);
+    return result;
+}
+
+PPM16_IMG contrast_enhancement_c_rgb16(PPM16_IMG img_in)
+{
+    PPM16_IMG result;
+    int img_size = img_in.w * img_in.h;
+    int nbr_bin = img_in.v_max + 1;
+    int * hist = (int *)arena_alloc(nbr_bin * sizeof(int));
+
+    result.w = img_in.w;
+    result.h = img_in.h;
+    result.v_max = img_in.v_max;
+    result.img_r = (unsigned short *)arena_alloc(img_size * sizeof(unsigned short));
+    result.img_g = (unsigned short *)arena_alloc(img_size * sizeof(unsigned short));
+    result.img_b = (unsigned short *)arena_alloc(img_size * sizeof(unsigned short));
+
+    histogram16(hist, img_in.img_r, img_size, nbr_bin);
+    histogram_equalization16(result.img_r, img_in.img_r, hist, img_size, nbr_bin);
+    histogram16(hist, img_in.img_g, img_size, nbr_bin);
+    histogram_equalization16(result.img_g, img_in.img_g, hist, img_size, nbr_bin);
+    histogram16(hist, img_in.img_b, img_size, nbr_bin);
+    histogram_equalization16(result.img_b, img_in.img_b, hist, img_size, nbr_bin);
+
+    arena_free(hist);
+    return result;
+}
+
+//Fused YUV engine: the Y plane is never materialised. The first pass
+//computes Y from RGB and accumulates its histogram, the second pass
+//recomputes Y/U/V block by block, remaps Y through the LUT and writes RGB.
+PPM_IMG contrast_enhancement_c_yuv(PPM_IMG img_in)
+{
+    PPM_IMG result;
+    int hist[256];
+    unsigned char lut[256];
+    int i, img_size;
+    long long total[256], total_size;
+    
+    img_size = img_in.w * img_in.h;
+    result.w = img_in.w;
+    result.h = img_in.h;
+    result.img_r = (unsigned char *)arena_alloc(result.w * result.h * sizeof(unsigned char));
+    result.img_g = (unsigned char *)arena_alloc(result.w * result.h * sizeof(unsigned char));
+    result.img_b = (unsigned char *)arena_alloc(result.w * result.h * sizeof(unsigned char));
+
+    for(i = 0; i < 256; i++)
+    {
+        hist[i] = 0;
+    }
+
+    #pragma omp parallel
+    {
+        unsigned int hist_priv[256] = {0};
+        unsigned char y_blk[HIST_BLOCK];
+        double r0 = prof_now();
+        double t0;
+        long start, end, j;
+        int n;
+
+        thread_range(img_size, omp_get_thread_num(), omp_get_num_threads(), &start, &end);
+        for(j = start; j < end; j += HIST_BLOCK)
+        {
+            n = (end - j < HIST_BLOCK) ? (int)(end - j) : HIST_BLOCK;
+            luma_block(y_blk, img_in.img_r + j, img_in.img_g + j, img_in.img_b + j, n);
+            t0 = prof_now();
+            histogram_kernel(hist_priv, y_blk, n);
+            prof_add(STAGE_HISTOGRAM, t0, n, n);
+        }
+
+        #pragma omp critical
+        {
+            for(j = 0; j < 256; j++)
+            {
+                hist[j] += (int)hist_priv[j];
+            }
+        }
+
+        trace_region("yuv pass 1", r0);
+    }
+
+    reduce_histogram(hist, 256, img_size, total, &total_size);
+    histogram_lut_u8_ll(lut, total, total_size, 256);
+
+    #pragma omp parallel
+    {
+        double r0 = prof_now();
+        long start, end, j;
+
+        // Same split as pass 1 and as read_ppm, which first touched the input
+        thread_range(img_size, omp_get_thread_num(), omp_get_num_threads(), &start, &end);
+        for(j = start; j < end; j += HIST_BLOCK)
+        {
+            int n = (end - j < HIST_BLOCK) ? (int)(end - j) : HIST_BLOCK;
+
+            yuv_equalize_block(result.img_r + j, result.img_g + j, result.img_b + j,
+                               img_in.img_r + j, img_in.img_g + j, img_in.img_b + j, lut, n);
+        }
+
+        trace_region("yuv pass 2", r0);
+    }
+    
+    return result;
+}
+
+//HSL lightness equalization without H/S planes. The first pass only
+//computes L and its histogram, the second pass recomputes H and S from
+//the original RGB and rebuilds RGB with the remapped lightness.
+PPM_IMG contrast_enhancement_c_hsl(PPM_IMG img_in)
+{
+    PPM_IMG result;
+    int hist[256];
+    unsigned char lut[256];
+    int i, img_size;
+    long long total[256], total_size;
+
+    img_size = img_in.w * img_in.h;
+    result.w = img_in.w;
+    result.h = img_in.h;
+    result.img_r = (unsigned char *)arena_alloc(result.w * result.h * sizeof(unsigned char));
+    result.img_g = (unsigned char *)arena_alloc(result.w * result.h * sizeof(unsigned char));
+    result.img_b = (unsigned char *)arena_alloc(result.w * result.h * sizeof(unsigned char));
+
+    for(i = 0; i < 256; i++)
+    {
+        hist[i] = 0;
+    }
+
+    #pragma omp parallel
+    {
+        unsigned int hist_priv[256] = {0};
+        unsigned char l_blk[HIST_BLOCK];
+        double r0 = prof_now();
+        double t0;
+        long start, end, j;
+        int n;
+
+        thread_range(img_size, omp_get_thread_num(), omp_get_num_threads(), &start, &end);
+        for(j = start; j < end; j += HIST_BLOCK)
+        {
+            n = (end - j < HIST_BLOCK) ? (int)(end - j) : HIST_BLOCK;
+            lightness_block(l_blk, img_in.img_r + j, img_in.img_g + j, img_in.img_b + j, n);
+            t0 = prof_now();
+            histogram_kernel(hist_priv, l_blk, n);
+            prof_add(STAGE_HISTOGRAM, t0, n, n);
+        }
+
+        #pragma omp critical
+        {
+            for(j = 0; j < 256; j++)
+            {
+                hist[j] += (int)hist_priv[j];
+            }
+        }
+
+        trace_region("hsl pass 1", r0);
+    }
+
+    reduce_histogram(hist, 256, img_size, total, &total_size);
+    histogram_lut_u8_ll(lut, total, total_size, 256);
+
+    #pragma omp parallel
+    {
+        double r0 = prof_now();
+        long start, end, j;
+
+        // Same split as pass 1 and as read_ppm, which first touched the input
+        thread_range(img_size, omp_get_thread_num(), omp_get_num_threads(), &start, &end);
+        for(j = start; j < end; j += HIST_BLOCK)
+        {
+            int n = (end - j < HIST_BLOCK) ? (int)(end - j) : HIST_BLOCK;
+
+            hsl_equalize_block(result.img_r + j, result.img_g + j, result.img_b + j,
+                               img_in.img_r + j, img_in.img_g + j, img_in.img_b + j, lut, n);
+        }
+
+        trace_region("hsl pass 2", r0);
+    }
+    
+    return result;
+}
+
+//Lightness of one RGB pixel in [0, 255], same arithmetic as rgb2hsl_pixel
+static inline unsigned char rgb2l_pixel(unsigned char r, unsigned char g, unsigned char b)
+{
+    float var_r = ( (float)r/255 );
+    float var_g = ( (float)g/255 );
+    float var_b = ( (float)b/255 );
+    float var_min = (var_r < var_g) ? var_r : var_g;
+    var_min = (var_min < var_b) ? var_min : var_b;
+    float var_max = (var_r > var_g) ? var_r : var_g;
+    var_max = (var_max > var_b) ? var_max : var_b;
+    float L = ( var_max + var_min ) / 2;
+
+    return (unsigned char)(L*255);
+}
+
+//Convert one RGB pixel to HSL, assume R,G,B in [0, 255]
+//Output H, S in [0.0, 1.0] and L in [0, 255]
+static inline void rgb2hsl_pixel(unsigned char r, unsigned char g, unsigned char b,
+                                 float * h, float * s, unsigned char * l)
+{
+    float H, S, L;
+    float var_r = ( (float)r/255 );//Convert RGB to [0,1]
+    float var_g = ( (float)g/255 );
+    float var_b = ( (float)b/255 );
+    float var_min = (var_r < var_g) ? var_r : var_g;
+    var_min = (var_min < var_b) ? var_min : var_b;   //min. value of RGB
+    float var_max = (var_r > var_g) ? var_r : var_g;
+    var_max = (var_max > var_b) ? var_max : var_b;   //max. value of RGB
+    float del_max = var_max - var_min;               //Delta RGB value
+
+    L = ( var_max + var_min ) / 2;
+    if ( del_max == 0 )//This is a gray, no chroma...
+    {
+        H = 0;         
+        S = 0;    
+    }
+    else                                    //Chromatic data...
+    {
+        if ( L < 0.5 )
+            S = del_max/(var_max+var_min);
+        else
+            S = del_max/(2-var_max-var_min );
+
+        float del_r = (((var_max-var_r)/6)+(del_max/2))/del_max;
+        float del_g = (((var_max-var_g)/6)+(del_max/2))/del_max;
+        float del_b = (((var_max-var_b)/6)+(del_max/2))/del_max;
+        
+        if( var_r == var_max )
+        {
+            H = del_b - del_g;
+        }
+        else
+        {       
+            if( var_g == var_max )
+            {
+                H = (1.0/3.0) + del_r - del_b;
+            }
+            else
+            {
+                H = (2.0/3.0) + del_g - del_r;
+            }   
+        }
+    }
+
+    if ( H < 0 )
+        H += 1;
+    if ( H > 1 )
+        H -= 1;
+
+    *h = H;
+    *s = S;
+    *l = (unsigned char)(L*255);
+}
+
+//Convert RGB to HSL, assume R,G,B in [0, 255]
+//Output H, S in [0.0, 1.0] and L in [0, 255]
+HSL_IMG rgb2hsl(PPM_IMG img_in)
+{
+    HSL_IMG img_out;// = (HSL_IMG *)malloc(sizeof(HSL_IMG));
+    img_out.width  = img_in.w;
+    img_out.height = img_in.h;
+    img_out.h = (float *)arena_alloc((size_t)img_in.w * img_in.h * sizeof(float));
+    img_out.s = (float *)arena_alloc((size_t)img_in.w * img_in.h * sizeof(float));
+    img_out.l = (unsigned char *)arena_alloc((size_t)img_in.w * img_in.h * sizeof(unsigned char));
+    
+    #pragma omp parallel
+    {
+        long start, end;
+        thread_range((long)img_in.w * img_in.h, omp_get_thread_num(), omp_get_num_threads(), &start, &end);
+        double t0 = prof_now();
+        long j;
+
+        for(j = start; j < end; ++j)
+        {
+            rgb2hsl_pixel(img_in.img_r[j], img_in.img_g[j], img_in.img_b[j],
+                          &img_out.h[j], &img_out.s[j], &img_out.l[j]);
+        }
+        prof_add(STAGE_CONVERT, t0, end - start, 12LL * (end - start));
+        trace_region("rgb2hsl", t0);
+    }
+
+    return img_out;
+}
+
+float Hue_2_RGB( float v1, float v2, float vH )             //Function Hue_2_RGB
+{
+    if ( vH < 0 ) vH += 1;
+    if ( vH > 1 ) vH -= 1;
+    if ( ( 6 * vH ) < 1 ) return ( v1 + ( v2 - v1 ) * 6 * vH );
+    if ( ( 2 * vH ) < 1 ) return ( v2 );
+    if ( ( 3 * vH ) < 2 ) return ( v1 + ( v2 - v1 ) * ( ( 2.0f/3.0f ) - vH ) * 6 );
+    return ( v1 );
+}
+
+//Convert one HSL pixel to RGB, assume H, S in [0.0, 1.0] and L in [0, 255]
+//Output R,G,B in [0, 255]
+static inline void hsl2rgb_pixel(float H, float S, unsigned char l,
+                                 unsigned char * r, unsigned char * g, unsigned char * b)
+{
+    float L = l/255.0f;
+    float var_1, var_2;
+    
+    if ( S == 0 )
+    {
+        *r = L * 255;
+        *g = L * 255;
+        *b = L * 255;
+    }
+    else
+    {            
+        if ( L < 0.5 )
+            var_2 = L * ( 1 + S );
+        else
+            var_2 = ( L + S ) - ( S * L );
+
+        var_1 = 2 * L - var_2;
+        *r = 255 * Hue_2_RGB( var_1, var_2, H + (1.0f/3.0f) );
+        *g = 255 * Hue_2_RGB( var_1, var_2, H );
+        *b = 255 * Hue_2_RGB( var_1, var_2, H - (1.0f/3.0f) );
+    }
+}
+
+//Convert HSL to RGB, assume H, S in [0.0, 1.0] and L in [0, 255]
+//Output R,G,B in [0, 255]
+PPM_IMG hsl2rgb(HSL_IMG img_in)
+{
+    PPM_IMG result;
+    
+    result.w = img_in.width;
+    result.h = img_in.height;
+    result.img_r = (unsigned char *)arena_alloc(result.w * result.h * sizeof(unsigned char));
+    result.img_g = (unsigned char *)arena_alloc(result.w * result.h * sizeof(unsigned char));
+    result.img_b = (unsigned char *)arena_alloc(result.w * result.h * sizeof(unsigned char));
+    
+    #pragma omp parallel
+    {
+        long start, end;
+        thread_range((long)img_in.width * img_in.height, omp_get_thread_num(), omp_get_num_threads(), &start, &end);
+        double t0 = prof_now();
+        long j;
+
+        for(j = start; j < end; ++j)
+        {
+            hsl2rgb_pixel(img_in.h[j], img_in.s[j], img_in.l[j],
+                          &result.img_r[j], &result.img_g[j], &result.img_b[j]);
+        }
+        prof_add(STAGE_RECONVERT, t0, end - start, 12LL * (end - start));
+        trace_region("hsl2rgb", t0);
+    }
+
+    return result;
+}
+
+//Block stages shared by the in-memory and streaming engines. They work on
+//n pixels of planar R/G/B in HIST_BLOCK chunks; outputs may alias inputs.
+
+//Y of each pixel, same fixed-point arithmetic as rgb2yuv
+void luma_block(unsigned char * y, const unsigned char * r, const unsigned char * g,
+                const unsigned char * b, int n)
+{
+    unsigned char u_blk[HIST_BLOCK], v_blk[HIST_BLOCK];
+    double t0 = prof_now();
+    int j, m;
+
+    for(j = 0; j < n; j += HIST_BLOCK)
+    {
+        m = (n - j < HIST_BLOCK) ? n - j : HIST_BLOCK;
+        rgb2yuv_kernel(y + j, u_blk, v_blk, r + j, g + j, b + j, m);
+    }
+    prof_add(STAGE_CONVERT, t0, n, 4LL * n);
+}
+
+//L of each pixel, same arithmetic as rgb2hsl
+void lightness_block(unsigned char * l, const unsigned char * r, const unsigned char * g,
+                     const unsigned char * b, int n)
+{
+    double t0 = prof_now();
+    int j;
+
+    for(j = 0; j < n; j++)
+    {
+        l[j] = rgb2l_pixel(r[j], g[j], b[j]);
+    }
+    prof_add(STAGE_CONVERT, t0, n, 4LL * n);
+}
+
+//Remap Y through lut and convert back to RGB
+void yuv_equalize_block(unsigned char * r_out, unsigned char * g_out, unsigned char * b_out,
+                        const unsigned char * r, const unsigned char * g, const unsigned char * b,
+                        const unsigned char * lut, int n)
+{
+    unsigned char y_blk[HIST_BLOCK], u_blk[HIST_BLOCK], v_blk[HIST_BLOCK];
+    double t0;
+    int j, m;
+
+    for(j = 0; j < n; j += HIST_BLOCK)
+    {
+        m = (n - j < HIST_BLOCK) ? n - j : HIST_BLOCK;
+        t0 = prof_now();
+        rgb2yuv_kernel(y_blk, u_blk, v_blk, r + j, g + j, b + j, m);
+        prof_add(STAGE_CONVERT, t0, m, 6LL * m);
+        t0 = prof_now();
+        lut_apply_kernel(y_blk, y_blk, lut, m);
+        prof_add(STAGE_APPLY, t0, m, 2LL * m);
+        t0 = prof_now();
+        yuv2rgb_kernel(r_out + j, g_out + j, b_out + j, y_blk, u_blk, v_blk, m);
+        prof_add(STAGE_RECONVERT, t0, m, 6LL * m);
+    }
+}
+
+//Remap L through lut and convert back to RGB
+void hsl_equalize_block(unsigned char * r_out, unsigned char * g_out, unsigned char * b_out,
+                        const unsigned char * r, const unsigned char * g, const unsigned char * b,
+                        const unsigned char * lut, int n)
+{
+    float h_blk[HIST_BLOCK], s_blk[HIST_BLOCK];
+    unsigned char l_blk[HIST_BLOCK];
+    double t0;
+    int j, k, m;
+
+    for(j = 0; j < n; j += HIST_BLOCK)
+    {
+        m = (n - j < HIST_BLOCK) ? n - j : HIST_BLOCK;
+
+        t0 = prof_now();
+        for(k = 0; k < m; k++)
+        {
+            rgb2hsl_pixel(r[j + k], g[j + k], b[j + k], &h_blk[k], &s_blk[k], &l_blk[k]);
+        }
+        prof_add(STAGE_CONVERT, t0, m, 12LL * m);
+
+        t0 = prof_now();
+        lut_apply_kernel(l_blk, l_blk, lut, m);
+        prof_add(STAGE_APPLY, t0, m, 2LL * m);
+
+        t0 = prof_now();
+        for(k = 0; k < m; k++)
+        {
+            hsl2rgb_pixel(h_blk[k], s_blk[k], l_blk[k], &r_out[j + k], &g_out[j + k], &b_out[j + k]);
+        }
+        prof_add(STAGE_RECONVERT, t0, m, 12LL * m);
+    }
+}
+
+//Replace Y by y_new and convert back to RGB
+void yuv_replace_block(unsigned char * r_out, unsigned char * g_out, unsigned char * b_out,
+                       const unsigned char * r, const unsigned char * g, const unsigned char * b,
+                       const unsigned char * y_new, int n)
+{
+    unsigned char y_blk[HIST_BLOCK], u_blk[HIST_BLOCK], v_blk[HIST_BLOCK];
+    double t0;
+    int j, m;
+
+    for(j = 0; j < n; j += HIST_BLOCK)
+    {
+        m = (n - j < HIST_BLOCK) ? n - j : HIST_BLOCK;
+        t0 = prof_now();
+        rgb2yuv_kernel(y_blk, u_blk, v_blk, r + j, g + j, b + j, m);
+        prof_add(STAGE_CONVERT, t0, m, 6LL * m);
+        t0 = prof_now();
+        yuv2rgb_kernel(r_out + j, g_out + j, b_out + j, y_new + j, u_blk, v_blk, m);
+        prof_add(STAGE_RECONVERT, t0, m, 6LL * m);
+    }
+}
+
+//Replace L by l_new and convert back to RGB
+void hsl_replace_block(unsigned char * r_out, unsigned char * g_out, unsigned char * b_out,
+                       const unsigned char * r, const unsigned char * g, const unsigned char * b,
+                       const unsigned char * l_new, int n)
+{
+    double t0 = prof_now();
+    int j;
+
+    for(j = 0; j < n; j++)
+    {
+        float H, S;
+        unsigned char L;
+
+        rgb2hsl_pixel(r[j], g[j], b[j], &H, &S, &L);
+        hsl2rgb_pixel(H, S, l_new[j], &r_out[j], &g_out[j], &b_out[j]);
+    }
+    prof_add(STAGE_RECONVERT, t0, n, 7LL * n);
+}
+
+//Convert RGB to YUV, all components in [0, 255]
+YUV_IMG rgb2yuv(PPM_IMG img_in)
+{
+    YUV_IMG img_out;
+    
+    img_out.w = img_in.w;
+    img_out.h = img_in.h;
+    img_out.img_y = (unsigned char *)arena_alloc(sizeof(unsigned char)*img_out.w*img_out.h);
+    img_out.img_u = (unsigned char *)arena_alloc(sizeof(unsigned char)*img_out.w*img_out.h);
+    img_out.img_v = (unsigned char *)arena_alloc(sizeof(unsigned char)*img_out.w*img_out.h);
+
+    #pragma omp parallel
+    {
+        long start, end;
+        thread_range((long)img_out.w * img_out.h, omp_get_thread_num(), omp_get_num_threads(), &start, &end);
+        double t0 = prof_now();
+
+        rgb2yuv_kernel(img_out.img_y + start, img_out.img_u + start, img_out.img_v + start,
+                       img_in.img_r + start, img_in.img_g + start, img_in.img_b + start,
+                       (int)(end - start));
+        prof_add(STAGE_CONVERT, t0, end - start, 6LL * (end - start));
+        trace_region("rgb2yuv", t0);
+    }
+    
+    return img_out;
+}
+
+//Convert YUV to RGB, all components in [0, 255]
+PPM_IMG yuv2rgb(YUV_IMG img_in)
+{
+    PPM_IMG img_out;
+        
+    img_out.w = img_in.w;
+    img_out.h = img_in.h;
+    img_out.img_r = (unsigned char *)arena_alloc(sizeof(unsigned char)*img_out.w*img_out.h);
+    img_out.img_g = (unsigned char *)arena_alloc(sizeof(unsigned char)*img_out.w*img_out.h);
+    img_out.img_b = (unsigned char *)arena_alloc(sizeof(unsigned char)*img_out.w*img_out.h);
+
+    #pragma omp parallel
+    {
+        long start, end;
+        thread_range((long)img_out.w * img_out.h, omp_get_thread_num(), omp_get_num_threads(), &start, &end);
+        double t0 = prof_now();
+
+        yuv2rgb_kernel(img_out.img_r + start, img_out.img_g + start, img_out.img_b + start,
+                       img_in.img_y + start, img_in.img_u + start, img_in.img_v + start,
+                       (int)(end - start));
+        prof_add(STAGE_RECONVERT, t0, end - start, 6LL * (end - start));
+        trace_region("yuv2rgb", t0);
+    }
+    
+    return img_out;
+}
@@ -0,0 +1,447 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "hist-equ.h"
+#include <time.h>
+#include <omp.h>
+
+void run_images(int packed, int nthreads);
+void run_cpu_color_test(PPM_IMG img_in);
+void run_cpu_gray_test(PGM_IMG img_in);
+void run_packed_color_test(RGB_IMG img_in);
+void run_stream_test(size_t mem_budget);
+void run_batch(int argc, char **argv, int nthreads);
+void run_sequence(int argc, char **argv);
+void run_clahe_test(PGM_IMG img_g, PPM_IMG img_c, const CLAHE_PARAMS * par);
+void run_gray16_test(PGM16_IMG img_in);
+void run_color16_test(PPM16_IMG img_in);
+
+// export OMP_NUM_THREADS=8 // Environment variable that sets the number of threads.
+// ./contrast [--backend serial|openmp|mpi|hybrid] [mode] // Executor, openmp by default; mpi and hybrid need an MPI build and mpirun.
+// ./contrast --stream [MB] // Out-of-core mode, at most MB megabytes (default 64) per strip.
+// ./contrast --packed // Color images stay interleaved from file to output.
+// ./contrast --clahe [tiles] [clip] // CLAHE on a tiles x tiles grid (default 8), clip limit (default 2).
+// ./contrast --batch [options] inputs... // Pipelined batch mode, see run_batch.
+// ./contrast --sequence [options] frames... // Frame sequence mode, see run_sequence.
+// Inputs with maxval > 255 go through the 16-bit path (gray and RGB only).
+// The modes and the 16-bit path need a single-process backend.
+
+int main(int argc, char **argv)
+{
+    const BACKEND * backend = backend_init(&argc, &argv);
+    int nthreads;
+    #pragma omp parallel
+    {
+        nthreads = omp_get_num_threads(); // Get number of threads
+    }
+
+    PGM_IMG img_ibuf_g;
+    PPM_IMG img_ibuf_c;
+
+    if (argc > 1 && !backend->local)
+    {
+        if (backend_rank() == 0)
+        {
+            printf("%s needs the serial or openmp backend!\n", argv[1]);
+        }
+        backend_finalize();
+        return 1;
+    }
+
+    if (argc > 1 && strcmp(argv[1], "--stream") == 0)
+    {
+        printf("Running out-of-core contrast enhancement with %d threads.\n", nthreads);
+        run_stream_test((size_t)(argc > 2 ? atol(argv[2]) : 64) << 20);
+    }
+    else if (argc > 1 && strcmp(argv[1], "--batch") == 0)
+    {
+        run_batch(argc - 2, argv + 2, nthreads);
+    }
+    else if (argc > 1 && strcmp(argv[1], "--sequence") == 0)
+    {
+        printf("Running frame sequence contrast enhancement with %d threads.\n", nthreads);
+        run_sequence(argc - 2, argv + 2);
+    }
+    else if (argc > 1 && strcmp(argv[1], "--clahe") == 0)
+    {
+        CLAHE_PARAMS par;
+
+        par.tiles_x = par.tiles_y = (argc > 2) ? atoi(argv[2]) : 8;
+        par.clip_limit = (argc > 3) ? (float)atof(argv[3]) : 2.0f;
+        img_ibuf_g = map_pgm("in.pgm");
+        img_ibuf_c = read_ppm("in.ppm");
+        printf("Running CLAHE (%d x %d tiles, clip %.2f) with %d threads.\n",
+               par.tiles_x, par.tiles_y, par.clip_limit, nthreads);
+        run_clahe_test(img_ibuf_g, img_ibuf_c, &par);
+        unmap_pgm(img_ibuf_g);
+        free_ppm(img_ibuf_c);
+    }
+    else
+    {
+        run_images(argc > 1 && strcmp(argv[1], "--packed") == 0, nthreads);
+    }
+
+    backend_finalize(); // Profile reports, then MPI_Finalize under MPI
+    return 0;
+}
+
+// in.pgm and in.ppm through the selected executor. Under MPI every process
+// reads its own part of the inputs and writes its part of the outputs.
+void run_images(int packed, int nthreads)
+{
+    const BACKEND * backend = backend_current();
+    int root = (backend_rank() == 0);
+    PGM_IMG img_ibuf_g;
+    PPM_IMG img_ibuf_c;
+    char workers[64];
+
+    memset(&img_ibuf_g, 0, sizeof(img_ibuf_g));
+    memset(&img_ibuf_c, 0, sizeof(img_ibuf_c));
+    if (backend->local)
+        snprintf(workers, sizeof(workers), "%d threads", nthreads);
+    else
+        snprintf(workers, sizeof(workers), "%d processes of %d threads", backend_size(), nthreads);
+
+    if (backend->local && read_pnm_maxval("in.pgm", '5') > 255)
+    {
+        PGM16_IMG img_ibuf_g16 = read_pgm16("in.pgm"); // Read 16-bit gray image
+
+        printf("Running 16-bit contrast enhancement for gray-scale images with %d threads.\n", nthreads);
+        run_gray16_test(img_ibuf_g16);
+        free_pgm16(img_ibuf_g16);
+    }
+    else
+    {
+        // With HIST_PIN the gray image is copied, so that every thread
+        // first-touches its own slice, instead of mapped from the page cache
+        int copy = placement_enabled() || backend->read_pgm != NULL;
+
+        if (backend->read_pgm != NULL)
+            img_ibuf_g = backend->read_pgm("in.pgm"); // This process's part
+        else if (copy)
+            img_ibuf_g = read_pgm("in.pgm");
+        else
+            img_ibuf_g = map_pgm("in.pgm"); // Map gray image, no copy
+        placement_check("in.pgm", img_ibuf_g.img, (long)img_ibuf_g.w * img_ibuf_g.h);
+        if (root)
+        {
+            printf("Running contrast enhancement for gray-scale images with %s.\n", workers);
+        }
+        run_cpu_gray_test(img_ibuf_g); // Compute gray image in sequential mode --> 500ms
+        if (backend->free_pgm != NULL)
+            backend->free_pgm(img_ibuf_g);
+        else if (copy)
+            free_pgm(img_ibuf_g);
+        else
+            unmap_pgm(img_ibuf_g); // Unmap buffer
+    }
+
+    if (backend->local && read_pnm_maxval("in.ppm", '6') > 255)
+    {
+        PPM16_IMG img_ibuf_c16 = read_ppm16("in.ppm"); // Read 16-bit color image
+
+        printf("Running 16-bit contrast enhancement for color images with %d threads.\n", nthreads);
+        run_color16_test(img_ibuf_c16);
+        free_ppm16(img_ibuf_c16);
+        return;
+    }
+
+    if (packed)
+    {
+        RGB_IMG img_ibuf_p = map_rgb("in.ppm"); // Map color image, no deinterleave
+
+        printf("Running packed contrast enhancement for color images with %d threads.\n", nthreads);
+        run_packed_color_test(img_ibuf_p);
+        unmap_rgb(img_ibuf_p); // Unmap buffer
+        return;
+    }
+
+    if (backend->read_ppm != NULL)
+        img_ibuf_c = backend->read_ppm("in.ppm"); // This process's part
+    else
+        img_ibuf_c = read_ppm("in.ppm"); // Read color image
+    placement_check("in.ppm", img_ibuf_c.img_r, (long)img_ibuf_c.w * img_ibuf_c.h);
+    if (root)
+    {
+        printf("Running contrast enhancement for color images with %s.\n", workers);
+    }
+    run_cpu_color_test(img_ibuf_c); // Compute color image in sequential mode --> 7700ms HSL / 3500ms YUV
+    if (backend->free_ppm != NULL)
+        backend->free_ppm(img_ibuf_c);
+    else
+        free_ppm(img_ibuf_c); // Free buffer
+}
+
+// The times cover enhancing this process's part and, under MPI, the barrier
+// after it, so every backend is timed the same way; writing is not timed
+void run_cpu_color_test(PPM_IMG img_in)
+{
+    const BACKEND * backend = backend_current();
+    int root = (backend_rank() == 0);
+    double start_hsl, end_hsl, result_time_hsl;
+    double start_yuv, end_yuv, result_time_yuv;
+    PPM_IMG img_obuf_hsl, img_obuf_yuv;
+    
+    if (root)
+    {
+        printf("Starting CPU processing...\n");
+    }
+    
+    start_hsl = omp_get_wtime(); // HSL start time
+    img_obuf_hsl = contrast_enhancement_c_hsl(img_in); // Run HSL contrast enhancement
+    if (backend->barrier != NULL)
+        backend->barrier();
+    end_hsl = omp_get_wtime(); // HSL end time
+
+    result_time_hsl = end_hsl - start_hsl; // HSL result time
+
+    if (root)
+    {
+        printf("HSL processing time: %lf (ms)\n", result_time_hsl * 1000.0);
+    }
+    if (backend->write_ppm != NULL)
+        backend->write_ppm(img_obuf_hsl, "out_hsl.ppm"); // Every process writes its part
+    else
+        write_ppm(img_obuf_hsl, "out_hsl.ppm");
+    free_ppm(img_obuf_hsl);
+
+    start_yuv = omp_get_wtime(); // YUV start time
+    img_obuf_yuv = contrast_enhancement_c_yuv(img_in); // Run YUV contrast enhancement
+    if (backend->barrier != NULL)
+        backend->barrier();
+    end_yuv = omp_get_wtime(); // YUV end time
+
+    result_time_yuv = end_yuv - start_yuv; // YUV result time
+    
+    if (root)
+    {
+        printf("YUV processing time: %lf (ms)\n", result_time_yuv * 1000.0);
+    }
+    if (backend->write_ppm != NULL)
+        backend->write_ppm(img_obuf_yuv, "out_yuv.ppm");
+    else
+        write_ppm(img_obuf_yuv, "out_yuv.ppm");
+    free_ppm(img_obuf_yuv);
+}
+
+void run_packed_color_test(RGB_IMG img_in)
+{
+    double start, end;
+    RGB_IMG img_obuf;
+
+    printf("Starting CPU processing...\n");
+
+    start = omp_get_wtime();
+    img_obuf = contrast_enhancement_packed(img_in, STREAM_HSL);
+    end = omp_get_wtime();
+    printf("HSL processing time: %lf (ms)\n", (end - start) * 1000.0);
+    write_rgb(img_obuf, "out_hsl.ppm");
+    free_rgb(img_obuf);
+
+    start = omp_get_wtime();
+    img_obuf = contrast_enhancement_packed(img_in, STREAM_YUV);
+    end = omp_get_wtime();
+    printf("YUV processing time: %lf (ms)\n", (end - start) * 1000.0);
+    write_rgb(img_obuf, "out_yuv.ppm");
+    free_rgb(img_obuf);
+}
+
+void run_cpu_gray_test(PGM_IMG img_in)
+{
+    const BACKEND * backend = backend_current();
+    int root = (backend_rank() == 0);
+    PGM_IMG img_obuf;
+    double start, end, result_time;
+    
+    if (root)
+    {
+        printf("Starting CPU processing...\n");
+    }
+
+    start = omp_get_wtime(); // Get start time
+    img_obuf = contrast_enhancement_g(img_in); // Run gray contrast enhancement
+    if (backend->barrier != NULL)
+        backend->barrier();
+    end = omp_get_wtime(); // Get end time
+
+    result_time = end - start; // Get result time
+    
+    if (root)
+    {
+        printf("Processing time: %lf (ms)\n", result_time * 1000.0);
+    }
+    if (backend->write_pgm != NULL)
+        backend->write_pgm(img_obuf, "out.pgm"); // Every process writes its part
+    else
+        write_pgm(img_obuf, "out.pgm");
+    free_pgm(img_obuf);
+}
+
+void run_clahe_test(PGM_IMG img_g, PPM_IMG img_c, const CLAHE_PARAMS * par)
+{
+    double start, end;
+    PGM_IMG out_g;
+    PPM_IMG out_c;
+
+    start = omp_get_wtime();
+    out_g = clahe_g(img_g, par);
+    end = omp_get_wtime();
+    printf("Gray CLAHE time: %lf (ms)\n", (end - start) * 1000.0);
+    write_pgm(out_g, "out_clahe.pgm");
+    free_pgm(out_g);
+
+    start = omp_get_wtime();
+    out_c = clahe_c(img_c, STREAM_HSL, par);
+    end = omp_get_wtime();
+    printf("HSL CLAHE time: %lf (ms)\n", (end - start) * 1000.0);
+    write_ppm(out_c, "out_clahe_hsl.ppm");
+    free_ppm(out_c);
+
+    start = omp_get_wtime();
+    out_c = clahe_c(img_c, STREAM_YUV, par);
+    end = omp_get_wtime();
+    printf("YUV CLAHE time: %lf (ms)\n", (end - start) * 1000.0);
+    write_ppm(out_c, "out_clahe_yuv.ppm");
+    free_ppm(out_c);
+}
+
+void run_gray16_test(PGM16_IMG img_in)
+{
+    PGM16_IMG img_obuf;
+    double start, end;
+
+    printf("Starting CPU processing...\n");
+
+    start = omp_get_wtime();
+    img_obuf = contrast_enhancement_g16(img_in);
+    end = omp_get_wtime();
+
+    printf("Processing time: %lf (ms)\n", (end - start) * 1000.0);
+    write_pgm16(img_obuf, "out.pgm");
+    free_pgm16(img_obuf);
+}
+
+void run_color16_test(PPM16_IMG img_in)
+{
+    PPM16_IMG img_obuf;
+    double start, end;
+
+    printf("Starting CPU processing...\n");
+
+    start = omp_get_wtime();
+    img_obuf = contrast_enhancement_c_rgb16(img_in);
+    end = omp_get_wtime();
+
+    printf("RGB processing time: %lf (ms)\n", (end - start) * 1000.0);
+    write_ppm16(img_obuf, "out_rgb.ppm");
+    free_ppm16(img_obuf);
+}
+
+void run_stream_test(size_t mem_budget)
+{
+    double start, end;
+
+    start = omp_get_wtime();
+    stream_contrast_enhancement_g("in.pgm", "out.pgm", mem_budget);
+    end = omp_get_wtime();
+    printf("Gray processing time: %lf (ms)\n", (end - start) * 1000.0);
+
+    start = omp_get_wtime();
+    stream_contrast_enhancement_c("in.ppm", "out_hsl.ppm", STREAM_HSL, mem_budget);
+    end = omp_get_wtime();
+    printf("HSL processing time: %lf (ms)\n", (end - start) * 1000.0);
+
+    start = omp_get_wtime();
+    stream_contrast_enhancement_c("in.ppm", "out_yuv.ppm", STREAM_YUV, mem_budget);
+    end = omp_get_wtime();
+    printf("YUV processing time: %lf (ms)\n", (end - start) * 1000.0);
+}
+
+// Options: --depth N (default 4), --readers N (1), --workers N (all threads),
+// --writers N (1), --mode yuv|hsl|rgb (yuv), --out DIR (out). Inputs are
+// .pgm/.ppm files, directories or @list files with one path per line.
+void run_batch(int argc, char **argv, int nthreads)
+{
+    BATCH_OPTIONS opt;
+    int i;
+
+    opt.depth = 4;
+    opt.readers = 1;
+    opt.workers = nthreads;
+    opt.writers = 1;
+    opt.mode = STREAM_YUV;
+    opt.out_dir = "out";
+
+    for (i = 0; i + 1 < argc && strncmp(argv[i], "--", 2) == 0; i += 2)
+    {
+        if (strcmp(argv[i], "--depth") == 0)
+            opt.depth = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--readers") == 0)
+            opt.readers = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--workers") == 0)
+            opt.workers = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--writers") == 0)
+            opt.writers = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--out") == 0)
+            opt.out_dir = argv[i + 1];
+        else if (strcmp(argv[i], "--mode") == 0)
+            opt.mode = strcmp(argv[i + 1], "hsl") == 0 ? STREAM_HSL :
+                       strcmp(argv[i + 1], "rgb") == 0 ? STREAM_RGB : STREAM_YUV;
+        else
+        {
+            printf("Unknown batch option %s!\n", argv[i]);
+            exit(1);
+        }
+    }
+
+    if (opt.depth < 1 || opt.readers < 1 || opt.workers < 1 || opt.writers < 1)
+    {
+        printf("Batch depth and thread counts must be positive!\n");
+        exit(1);
+    }
+
+    batch_contrast_enhancement(argv + i, argc - i, &opt);
+}
+
+// Options: --window N (default 1, no smoothing), --overlap, --mode yuv|hsl|rgb
+// (yuv), --out DIR (out). Frames are taken in order from files, directories
+// (sorted by name) or @list files.
+void run_sequence(int argc, char **argv)
+{
+    SEQUENCE_OPTIONS opt;
+    int i;
+
+    opt.window = 1;
+    opt.overlap = 0;
+    opt.mode = STREAM_YUV;
+    opt.out_dir = "out";
+
+    for (i = 0; i < argc && strncmp(argv[i], "--", 2) == 0; i++)
+    {
+        if (strcmp(argv[i], "--overlap") == 0)
+            opt.overlap = 1;
+        else if (i + 1 < argc && strcmp(argv[i], "--window") == 0)
+            opt.window = atoi(argv[++i]);
+        else if (i + 1 < argc && strcmp(argv[i], "--out") == 0)
+            opt.out_dir = argv[++i];
+        else if (i + 1 < argc && strcmp(argv[i], "--mode") == 0)
+        {
+            i++;
+            opt.mode = strcmp(argv[i], "hsl") == 0 ? STREAM_HSL :
+                       strcmp(argv[i], "rgb") == 0 ? STREAM_RGB : STREAM_YUV;
+        }
+        else
+        {
+            printf("Unknown sequence option %s!\n", argv[i]);
+            exit(1);
+        }
+    }
+
+    if (opt.window < 1)
+    {
+        printf("Sequence window must be positive!\n");
+        exit(1);
+    }
+
+    sequence_contrast_enhancement(argv + i, argc - i, &opt);
+}
@@ -0,0 +1,308 @@
+#ifndef HIST_EQU_COLOR_H
+#define HIST_EQU_COLOR_H
+
+#include <stdio.h>
+
+typedef struct{
+    int w;
+    int h;
+    unsigned char * img;
+} PGM_IMG;    
+
+typedef struct{
+    int w;
+    int h;
+    unsigned char * img_r;
+    unsigned char * img_g;
+    unsigned char * img_b;
+} PPM_IMG;
+
+typedef struct{
+    int w;
+    int h;
+    unsigned char * img;    // interleaved R, G, B as in the file
+} RGB_IMG;
+
+typedef struct{
+    int w;
+    int h;
+    int v_max;              // maxval, up to 65535
+    unsigned short * img;
+} PGM16_IMG;
+
+typedef struct{
+    int w;
+    int h;
+    int v_max;
+    unsigned short * img_r;
+    unsigned short * img_g;
+    unsigned short * img_b;
+} PPM16_IMG;
+
+typedef struct{
+    int w;
+    int h;
+    unsigned char * img_y;
+    unsigned char * img_u;
+    unsigned char * img_v;
+} YUV_IMG;
+
+
+typedef struct
+{
+    int width;
+    int height;
+    float * h;
+    float * s;
+    unsigned char * l;
+} HSL_IMG;
+
+    
+
+typedef enum
+{
+    STAGE_READ,
+    STAGE_DEINTERLEAVE,
+    STAGE_CONVERT,
+    STAGE_HISTOGRAM,
+    STAGE_LUT,
+    STAGE_APPLY,
+    STAGE_RECONVERT,
+    STAGE_INTERLEAVE,
+    STAGE_WRITE,
+    STAGE_SCATTER,         // MPI executor only
+    STAGE_ALLREDUCE,
+    STAGE_GATHER,
+    STAGE_BARRIER,
+    STAGE_COUNT
+} STAGE;
+
+typedef enum
+{
+    STREAM_RGB,
+    STREAM_YUV,
+    STREAM_HSL
+} STREAM_MODE;
+
+typedef struct
+{
+    int depth;             // images in flight between two stages
+    int readers;           // reader threads
+    int workers;           // threads of the enhancement team
+    int writers;           // writer threads
+    STREAM_MODE mode;      // color enhancement used for .ppm inputs
+    const char * out_dir;
+} BATCH_OPTIONS;
+
+typedef struct
+{
+    int window;            // frames whose histograms are averaged
+    int overlap;           // apply frame N in the histogram pass of frame N+1
+    STREAM_MODE mode;
+    const char * out_dir;
+} SEQUENCE_OPTIONS;
+
+typedef struct
+{
+    int tiles_x;           // tile grid
+    int tiles_y;
+    float clip_limit;      // times the mean bin count, <= 0 disables clipping
+} CLAHE_PARAMS;
+
+//Executor of the enhancement passes, picked at runtime with --backend.
+//read_* give every process its part of an image file, released with
+//free_*, and write_* store the enhanced part of every process in the
+//output file; the single-process executors have none of them (the whole
+//image is read, written and freed as usual).
+//reduce_histogram sums the 64-bit histograms and pixel counts of
+//the parts in place, so that every process builds the LUT of the whole
+//image; NULL when there is only one part.
+typedef struct
+{
+    const char * name;
+    int local;             // one process, every mode is available
+    void (*init)(int * argc, char *** argv);   // NULL when there is nothing to set up
+    void (*finalize)(void);
+    PGM_IMG (*read_pgm)(const char * path);
+    void (*write_pgm)(PGM_IMG part, const char * path);
+    void (*free_pgm)(PGM_IMG part);
+    PPM_IMG (*read_ppm)(const char * path);
+    void (*write_ppm)(PPM_IMG part, const char * path);
+    void (*free_ppm)(PPM_IMG part);
+    void (*reduce_histogram)(long long * hist, int nbr_bin, long long * img_size);
+    void (*barrier)(void);
+} BACKEND;
+
+const BACKEND * backend_init(int * argc, char *** argv);
+const BACKEND * backend_current(void);
+void backend_finalize(void);
+int backend_rank(void);
+int backend_size(void);
+void backend_set_process(int rank, int size);
+void reduce_histogram(const int * hist, int nbr_bin, int part_size, long long * total, long long * img_size);
+
+#ifdef HIST_MPI
+extern const BACKEND mpi_backend;
+extern const BACKEND hybrid_backend;
+#endif
+
+//Per-stage instrumentation, enabled by HIST_PROFILE=<json file>;
+//HIST_TRACE=<json file> also writes a Chrome/Perfetto timeline.
+//Under MPI prof_report is collective and runs before MPI_Finalize.
+double prof_now(void);
+void prof_add(STAGE stage, double t0, long long pixels, long long bytes);
+void trace_region(const char * name, double t0);
+void prof_report(void);
+
+//Cycles, instructions, LLC misses and branch misses of the calling thread
+#define PERF_COUNTERS 4
+int perf_counters_open(void);
+int perf_counters_read(long long values[PERF_COUNTERS]);
+const char * perf_counters_error(void);
+
+//Pixels [*start, *end) of thread id of nth in a pass over n pixels. Every
+//pass over a plane splits it the same way, in whole PLANE_BLOCK-pixel runs,
+//so the thread that first touches a page of a plane (read_ppm, read_pgm or
+//the first pass writing it) is the one that works on that page afterwards,
+//and with HIST_PIN its memory stays on the NUMA node of that thread
+#define PLANE_BLOCK 4096
+static inline void thread_range(long n, int id, int nth, long * start, long * end)
+{
+    long blocks = (n + PLANE_BLOCK - 1) / PLANE_BLOCK;
+    long first = blocks * id / nth * PLANE_BLOCK;
+    long last = blocks * (id + 1) / nth * PLANE_BLOCK;
+
+    *start = (first < n) ? first : n;
+    *end = (last < n) ? last : n;
+}
+
+//HIST_PIN=compact|spread pins the OpenMP threads to CPUs and prints where
+//they run, HIST_PIN=report only prints it; placement_check reports how many
+//pages of a plane are on the node of the thread that processes them
+void placement_init(void);
+int placement_enabled(void);
+void placement_unpin(void);
+void placement_check(const char * name, const unsigned char * plane, long n);
+
+//64-byte aligned planes and scratch (page aligned from a page up),
+//recycled across calls and frames
+void * arena_alloc(size_t bytes);
+void arena_free(void * ptr);
+void arena_trim(void);
+
+long read_pnm_header(FILE * in_file, char magic, int * w, int * h, int * v_max, const char * path);
+
+PPM_IMG read_ppm(const char * path);
+void deinterleave_ppm(PPM_IMG img, const unsigned char * ibuf);
+void write_ppm(PPM_IMG img, const char * path);
+void interleave_ppm(unsigned char * obuf, PPM_IMG img);
+void free_ppm(PPM_IMG img);
+
+RGB_IMG map_rgb(const char * path);
+void unmap_rgb(RGB_IMG img);
+void write_rgb(RGB_IMG img, const char * path);
+void free_rgb(RGB_IMG img);
+
+PGM_IMG read_pgm(const char * path);
+PGM_IMG map_pgm(const char * path);
+void unmap_pgm(PGM_IMG img);
+void write_pgm(PGM_IMG img, const char * path);
+void free_pgm(PGM_IMG img);
+
+int read_pnm_maxval(const char * path, char magic);
+PGM16_IMG read_pgm16(const char * path);
+void write_pgm16(PGM16_IMG img, const char * path);
+void free_pgm16(PGM16_IMG img);
+PPM16_IMG read_ppm16(const char * path);
+void write_ppm16(PPM16_IMG img, const char * path);
+void free_ppm16(PPM16_IMG img);
+
+HSL_IMG rgb2hsl(PPM_IMG img_in);
+PPM_IMG hsl2rgb(HSL_IMG img_in);
+
+YUV_IMG rgb2yuv(PPM_IMG img_in);
+PPM_IMG yuv2rgb(YUV_IMG img_in);    
+
+void rgb2yuv_kernel(unsigned char * y, unsigned char * u, unsigned char * v,
+                    const unsigned char * r, const unsigned char * g,
+                    const unsigned char * b, int n);
+void yuv2rgb_kernel(unsigned char * r, unsigned char * g, unsigned char * b,
+                    const unsigned char * y, const unsigned char * u,
+                    const unsigned char * v, int n);
+const char * color_kernel_name(void);
+
+void histogram_kernel(unsigned int * hist_out, const unsigned char * img_in, int img_size);
+const char * histogram_kernel_name(void);
+void lut_apply_kernel(unsigned char * img_out, const unsigned char * img_in,
+                      const unsigned char * lut, int img_size);
+const char * lut_apply_kernel_name(void);
+
+void histogram(int * hist_out, unsigned char * img_in, int img_size, int nbr_bin);
+void histogram_lut(int * lut, int * hist_in, int img_size, int nbr_bin);
+void histogram_lut_u8(unsigned char * lut, int * hist_in, int img_size, int nbr_bin);
+void histogram_lut_u8_ll(unsigned char * lut, const long long * hist_in, long long img_size, int nbr_bin);
+void histogram_equalization(unsigned char * img_out, unsigned char * img_in, 
+                            int * hist_in, int img_size, int nbr_bin);
+void histogram16(int * hist_out, const unsigned short * img_in, int img_size, int nbr_bin);
+void histogram_lut16(unsigned short * lut, int * hist_in, int img_size, int nbr_bin);
+void histogram_equalization16(unsigned short * img_out, const unsigned short * img_in,
+                              int * hist_in, int img_size, int nbr_bin);
+
+//Block stages of the fused YUV/HSL engines, n pixels of planar RGB
+void luma_block(unsigned char * y, const unsigned char * r, const unsigned char * g,
+                const unsigned char * b, int n);
+void lightness_block(unsigned char * l, const unsigned char * r, const unsigned char * g,
+                     const unsigned char * b, int n);
+void yuv_equalize_block(unsigned char * r_out, unsigned char * g_out, unsigned char * b_out,
+                        const unsigned char * r, const unsigned char * g, const unsigned char * b,
+                        const unsigned char * lut, int n);
+void hsl_equalize_block(unsigned char * r_out, unsigned char * g_out, unsigned char * b_out,
+                        const unsigned char * r, const unsigned char * g, const unsigned char * b,
+                        const unsigned char * lut, int n);
+void yuv_replace_block(unsigned char * r_out, unsigned char * g_out, unsigned char * b_out,
+                       const unsigned char * r, const unsigned char * g, const unsigned char * b,
+                       const unsigned char * y_new, int n);
+void hsl_replace_block(unsigned char * r_out, unsigned char * g_out, unsigned char * b_out,
+                       const unsigned char * r, const unsigned char * g, const unsigned char * b,
+                       const unsigned char * l_new, int n);
+
+//Contrast enhancement for gray-scale images
+PGM_IMG contrast_enhancement_g(PGM_IMG img_in);
+
+//Contrast enhancement for 16-bit images, RGB channels only for color
+PGM16_IMG contrast_enhancement_g16(PGM16_IMG img_in);
+PPM16_IMG contrast_enhancement_c_rgb16(PPM16_IMG img_in);
+
+//Contrast enhancement for color images
+PPM_IMG contrast_enhancement_c_rgb(PPM_IMG img_in);
+PPM_IMG contrast_enhancement_c_yuv(PPM_IMG img_in);
+PPM_IMG contrast_enhancement_c_hsl(PPM_IMG img_in);
+
+//Contrast enhancement for packed RGB images and strips of packed pixels
+RGB_IMG contrast_enhancement_packed(RGB_IMG img_in, STREAM_MODE mode);
+void packed_histogram(long long total[3][256], const unsigned char * rgb, long n, STREAM_MODE mode);
+void packed_lut(unsigned char lut[3][256], long long total[3][256], long long img_size, STREAM_MODE mode);
+void packed_equalize(unsigned char * rgb_out, const unsigned char * rgb_in,
+                     unsigned char lut[3][256], long n, STREAM_MODE mode);
+
+//Contrast-limited adaptive histogram equalization, per tile LUTs
+void clahe_plane(unsigned char * img_out, const unsigned char * img_in, int w, int h,
+                 const CLAHE_PARAMS * par);
+PGM_IMG clahe_g(PGM_IMG img_in, const CLAHE_PARAMS * par);
+PPM_IMG clahe_c(PPM_IMG img_in, STREAM_MODE mode, const CLAHE_PARAMS * par);
+
+//Out-of-core contrast enhancement, file to file within mem_budget bytes
+void stream_contrast_enhancement_g(const char * in_path, const char * out_path, size_t mem_budget);
+void stream_contrast_enhancement_c(const char * in_path, const char * out_path,
+                                   STREAM_MODE mode, size_t mem_budget);
+
+//Pipelined batch mode over files, directories and @list files
+void batch_contrast_enhancement(char ** inputs, int ninputs, const BATCH_OPTIONS * opt);
+char ** collect_inputs(char ** args, int nargs, int * count);
+void prepare_outputs(const char * out_dir, char ** files, int nfiles);
+
+//Frame sequence with LUTs smoothed over a window of frames
+void sequence_contrast_enhancement(char ** inputs, int ninputs, const SEQUENCE_OPTIONS * opt);
+
+
+#endif
@@ -0,0 +1,294 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "hist-equ.h"
+#include <time.h>
+#include <omp.h>
+
+void histogram(int * hist_out, unsigned char * img_in, int img_size, int nbr_bin)
+{
+    int numThreads;
+    unsigned int * hist_buff;
+
+    numThreads = omp_get_max_threads();
+
+    // One 256-bin buffer per thread; 256 counters are 1 KB, so every buffer
+    // starts on its own cache line and threads never share a line. The
+    // scratch comes from the arena and is reused by the next call.
+    hist_buff = (unsigned int *)arena_alloc(numThreads * 256 * sizeof(unsigned int));
+
+    #pragma omp parallel num_threads(numThreads)
+    {
+        int id = omp_get_thread_num();
+        int nth = omp_get_num_threads();
+        long start, end;
+        thread_range((long)img_size, id, nth, &start, &end);
+        unsigned int * own = hist_buff + id * 256;
+        double t0 = prof_now();
+        int j, t;
+
+        memset(own, 0, 256 * sizeof(unsigned int));
+        histogram_kernel(own, img_in + start, (int)(end - start));
+        prof_add(STAGE_HISTOGRAM, t0, end - start, end - start);
+
+        #pragma omp barrier
+
+        #pragma omp for schedule(static)
+            for (j = 0; j < nbr_bin; j++)
+            {
+                unsigned int sum = 0;
+
+                if (j < 256)
+                {
+                    for (t = 0; t < nth; t++)
+                    {
+                        sum += hist_buff[t * 256 + j];
+                    }
+                }
+                hist_out[j] = (int)sum;
+            }
+
+        trace_region("histogram", t0);
+    }
+
+    arena_free(hist_buff);
+}
+
+void histogram_lut(int * lut, int * hist_in, int img_size, int nbr_bin)
+{
+    int i, cdf, min, d;
+    /* Construct the LUT by calculating the CDF */
+    cdf = 0;
+    min = 0;
+    i = 0;
+
+    while(min == 0)
+    {
+        min = hist_in[i++];
+    }
+    
+    d = img_size - min;
+    
+    // #pragma omp parallel for schedule(dynamic) ordered // The execution time is not improved.
+    for(i = 0; i < nbr_bin; i++)
+    {
+        cdf += hist_in[i];
+        //lut[i] = (cdf - min)*(nbr_bin - 1)/d;
+        lut[i] = (int)(((float)cdf - min)*255/d + 0.5);
+        if(lut[i] < 0)
+        {
+            lut[i] = 0;
+        }
+    }
+}
+
+//LUT clamped to [0, 255] and narrowed to one byte per bin
+void histogram_lut_u8(unsigned char * lut, int * hist_in, int img_size, int nbr_bin)
+{
+    int *lut_int = (int *)malloc(sizeof(int)*nbr_bin);
+    double t0 = prof_now();
+    int i;
+
+    histogram_lut(lut_int, hist_in, img_size, nbr_bin);
+    for(i = 0; i < nbr_bin; i++)
+    {
+        lut[i] = (lut_int[i] > 255) ? 255 : (unsigned char)lut_int[i];
+    }
+
+    free(lut_int);
+    prof_add(STAGE_LUT, t0, 0, (long long)nbr_bin * sizeof(int));
+}
+
+//histogram_lut_u8 for 64-bit counts, like those summed over a streamed image
+void histogram_lut_u8_ll(unsigned char * lut, const long long * hist_in, long long img_size, int nbr_bin)
+{
+    long long cdf = 0, min = 0, d;
+    double t0 = prof_now();
+    int i = 0, v;
+
+    while(min == 0)
+    {
+        min = hist_in[i++];
+    }
+
+    d = img_size - min;
+
+    for(i = 0; i < nbr_bin; i++)
+    {
+        cdf += hist_in[i];
+        v = (int)(((float)cdf - min)*255/d + 0.5);
+        lut[i] = (v < 0) ? 0 : (v > 255) ? 255 : (unsigned char)v;
+    }
+
+    prof_add(STAGE_LUT, t0, 0, (long long)nbr_bin * sizeof(long long));
+}
+
+void histogram_equalization(unsigned char * img_out, unsigned char * img_in, 
+                            int * hist_in, int img_size, int nbr_bin)
+{
+    unsigned char lut[256];
+    long long total[256], total_size;
+
+    // LUT of the whole image, even when this is only a part of it
+    reduce_histogram(hist_in, nbr_bin, img_size, total, &total_size);
+    histogram_lut_u8_ll(lut, total, total_size, nbr_bin);
+
+    #pragma omp parallel
+    {
+        long start, end;
+        thread_range((long)img_size, omp_get_thread_num(), omp_get_num_threads(), &start, &end);
+        double t0 = prof_now();
+
+        /* Get the result image */
+        lut_apply_kernel(img_out + start, img_in + start, lut, (int)(end - start));
+        prof_add(STAGE_APPLY, t0, end - start, 2 * (end - start));
+        trace_region("equalize", t0);
+    }
+}
+
+// 16-bit histograms. nbr_bin is maxval + 1, up to 65536. Every thread
+// counts its slice into a private nbr_bin-bin buffer, then the buffers are
+// reduced bin-parallel.
+void histogram16(int * hist_out, const unsigned short * img_in, int img_size, int nbr_bin)
+{
+    int numThreads = omp_get_max_threads();
+    unsigned int * hist_buff;
+
+    hist_buff = (unsigned int *)arena_alloc((size_t)numThreads * nbr_bin * sizeof(unsigned int));
+
+    #pragma omp parallel num_threads(numThreads)
+    {
+        int id = omp_get_thread_num();
+        int nth = omp_get_num_threads();
+        long start, end;
+        thread_range((long)img_size, id, nth, &start, &end);
+        unsigned int * own = hist_buff + (long)id * nbr_bin;
+        double t0 = prof_now();
+        long i;
+        int j, t;
+
+        memset(own, 0, nbr_bin * sizeof(unsigned int));
+        for (i = start; i < end; i++)
+        {
+            own[img_in[i]]++;
+        }
+        prof_add(STAGE_HISTOGRAM, t0, end - start, 2 * (end - start));
+
+        #pragma omp barrier
+
+        #pragma omp for schedule(static)
+            for (j = 0; j < nbr_bin; j++)
+            {
+                unsigned int sum = 0;
+
+                for (t = 0; t < nth; t++)
+                {
+                    sum += hist_buff[(long)t * nbr_bin + j];
+                }
+                hist_out[j] = (int)sum;
+            }
+
+        trace_region("histogram16", t0);
+    }
+
+    arena_free(hist_buff);
+}
+
+// LUT from the CDF computed with a parallel prefix sum: each thread sums its
+// block of bins, the block totals are scanned, then each thread rescans its
+// block from that offset
+void histogram_lut16(unsigned short * lut, int * hist_in, int img_size, int nbr_bin)
+{
+    int numThreads = omp_get_max_threads();
+    long long * block_sum = (long long *)arena_alloc((numThreads + 1) * sizeof(long long));
+    double t0 = prof_now();
+    int i, min = 0;
+    long long d;
+
+    for (i = 0; i < nbr_bin && min == 0; i++)
+    {
+        min = hist_in[i];
+    }
+    d = (long long)img_size - min;
+
+    // A flat image has nothing to stretch
+    if (d <= 0)
+    {
+        for (i = 0; i < nbr_bin; i++)
+        {
+            lut[i] = (unsigned short)i;
+        }
+        arena_free(block_sum);
+        prof_add(STAGE_LUT, t0, 0, (long long)nbr_bin * 6);
+        return;
+    }
+
+    #pragma omp parallel num_threads(numThreads)
+    {
+        int id = omp_get_thread_num();
+        int nth = omp_get_num_threads();
+        int start = (int)((long)nbr_bin * id / nth);
+        int end = (int)((long)nbr_bin * (id + 1) / nth);
+        double r0 = prof_now();
+        long long cdf = 0;
+        int j;
+
+        for (j = start; j < end; j++)
+        {
+            cdf += hist_in[j];
+        }
+        block_sum[id + 1] = cdf;
+
+        #pragma omp barrier
+        #pragma omp single
+        {
+            block_sum[0] = 0;
+            for (j = 1; j <= nth; j++)
+            {
+                block_sum[j] += block_sum[j - 1];
+            }
+        }
+
+        cdf = block_sum[id];
+        for (j = start; j < end; j++)
+        {
+            double v;
+
+            cdf += hist_in[j];
+            v = ((double)cdf - min) * (nbr_bin - 1) / d + 0.5;
+            lut[j] = (v < 0) ? 0 : (unsigned short)v;
+        }
+
+        trace_region("lut16", r0);
+    }
+
+    arena_free(block_sum);
+    prof_add(STAGE_LUT, t0, 0, (long long)nbr_bin * 6);
+}
+
+void histogram_equalization16(unsigned short * img_out, const unsigned short * img_in,
+                              int * hist_in, int img_size, int nbr_bin)
+{
+    unsigned short * lut = (unsigned short *)arena_alloc(nbr_bin * sizeof(unsigned short));
+
+    // The 16-bit path runs on single-process backends only, so hist_in
+    // already covers the whole image
+    histogram_lut16(lut, hist_in, img_size, nbr_bin);
+
+    #pragma omp parallel
+    {
+        long start, end;
+        thread_range((long)img_size, omp_get_thread_num(), omp_get_num_threads(), &start, &end);
+        double t0 = prof_now();
+        long j;
+
+        for (j = start; j < end; j++)
+        {
+            img_out[j] = lut[img_in[j]];
+        }
+        prof_add(STAGE_APPLY, t0, end - start, 4 * (end - start));
+        trace_region("equalize16", t0);
+    }
+
+    arena_free(lut);
+}
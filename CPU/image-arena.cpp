@@ -0,0 +1,177 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include "hist-equ.h"
+#include <omp.h>
+
+// Arena for image planes and histogram scratch. Blocks are 64-byte aligned,
+// and page aligned from a page up, so no page is first touched by two
+// threads under thread_range. Freed blocks are kept for the next frame of
+// the same size, whose memory is then already faulted in. With
+// HIST_ARENA_THP=1 blocks of 2 MB and more are huge-page aligned and
+// advised for transparent huge pages. Idle blocks are capped at
+// HIST_ARENA_IDLE_MB megabytes (default 1024); past that the largest idle
+// blocks go back to the system, so frames of changing sizes do not pile up.
+
+#define ARENA_ALIGN 64
+#define ARENA_PAGE 4096
+#define ARENA_HUGE_PAGE (2UL << 20)
+#define ARENA_SLOTS 256
+#define ARENA_IDLE_MB 1024
+
+typedef struct
+{
+    void * ptr;
+    size_t bytes;          // capacity
+    int in_use;
+} ARENA_BLOCK;
+
+static ARENA_BLOCK arena[ARENA_SLOTS];
+static int arena_thp = 0;
+static size_t idle_bytes = 0;              // capacity of the idle blocks
+static size_t idle_cap = (size_t)ARENA_IDLE_MB << 20;
+
+// Before main, so no thread reads the settings while they are set
+__attribute__((constructor))
+static void arena_settings(void)
+{
+    const char * env = getenv("HIST_ARENA_THP");
+
+    arena_thp = (env != NULL && atoi(env) != 0);
+    env = getenv("HIST_ARENA_IDLE_MB");
+    if (env != NULL && env[0] != '\0')
+        idle_cap = (size_t)atol(env) << 20;
+}
+
+void * arena_alloc(size_t bytes)
+{
+    void * ptr = NULL;
+    size_t align, cap;
+    int i, best = -1, empty = -1;
+
+    if (bytes == 0)
+        bytes = 1;
+
+    // Best fit among idle blocks, but never more than twice the request so a
+    // small scratch request does not pin a whole plane
+    #pragma omp critical(arena)
+    {
+        for (i = 0; i < ARENA_SLOTS; i++)
+        {
+            if (arena[i].ptr == NULL)
+            {
+                if (empty < 0)
+                    empty = i;
+            }
+            else if (!arena[i].in_use && arena[i].bytes >= bytes && arena[i].bytes / 2 <= bytes &&
+                     (best < 0 || arena[i].bytes < arena[best].bytes))
+            {
+                best = i;
+            }
+        }
+
+        if (best >= 0)
+        {
+            arena[best].in_use = 1;
+            idle_bytes -= arena[best].bytes;
+            ptr = arena[best].ptr;
+        }
+        else if (empty >= 0)
+        {
+            arena[empty].in_use = 1;   // reserve the slot
+            arena[empty].ptr = (void *)1;
+        }
+    }
+
+    if (ptr != NULL)
+        return ptr;
+
+    if (arena_thp && bytes >= ARENA_HUGE_PAGE)
+        align = ARENA_HUGE_PAGE;
+    else
+        align = (bytes >= ARENA_PAGE) ? ARENA_PAGE : ARENA_ALIGN;
+    cap = (bytes + align - 1) / align * align;
+    ptr = aligned_alloc(align, cap);
+    if (ptr == NULL)
+    {
+        printf("Cannot allocate %zu bytes!\n", cap);
+        exit(1);
+    }
+    if (align == ARENA_HUGE_PAGE)
+        madvise(ptr, cap, MADV_HUGEPAGE);
+
+    // With every slot taken the block is untracked and arena_free frees it
+    if (empty >= 0)
+    {
+        #pragma omp critical(arena)
+        {
+            arena[empty].ptr = ptr;
+            arena[empty].bytes = cap;
+        }
+    }
+
+    return ptr;
+}
+
+// Hand a block back for reuse; pointers the arena does not know are freed.
+// Above the idle cap the largest idle blocks are released, this one included.
+void arena_free(void * ptr)
+{
+    int i, found = 0, largest;
+
+    if (ptr == NULL)
+        return;
+
+    #pragma omp critical(arena)
+    {
+        for (i = 0; i < ARENA_SLOTS; i++)
+        {
+            if (arena[i].ptr == ptr)
+            {
+                arena[i].in_use = 0;
+                idle_bytes += arena[i].bytes;
+                found = 1;
+                break;
+            }
+        }
+
+        while (found && idle_bytes > idle_cap)
+        {
+            largest = -1;
+            for (i = 0; i < ARENA_SLOTS; i++)
+            {
+                if (arena[i].ptr != NULL && !arena[i].in_use &&
+                    (largest < 0 || arena[i].bytes > arena[largest].bytes))
+                    largest = i;
+            }
+            idle_bytes -= arena[largest].bytes;
+            free(arena[largest].ptr);
+            arena[largest].ptr = NULL;
+            arena[largest].bytes = 0;
+        }
+    }
+
+    if (!found)
+        free(ptr);
+}
+
+// Return every idle block to the system
+void arena_trim(void)
+{
+    int i;
+
+    #pragma omp critical(arena)
+    {
+        for (i = 0; i < ARENA_SLOTS; i++)
+        {
+            if (arena[i].ptr != NULL && !arena[i].in_use)
+            {
+                free(arena[i].ptr);
+                arena[i].ptr = NULL;
+                arena[i].bytes = 0;
+            }
+        }
+        idle_bytes = 0;
+    }
+}
@@ -0,0 +1,638 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "hist-equ.h"
+#include <omp.h>
+
+// PPM/PGM files are read through a private memory mapping: the header is
+// parsed in place and the pixels are deinterleaved (PPM) or copied (PGM)
+// straight from the mapped pages by all OpenMP threads. map_pgm and map_rgb
+// hand the mapped pixels to the caller without any copy.
+
+// Map a whole file; the mapping is private so pixels can be written in place
+// without touching the file
+static unsigned char * map_file(const char * path, size_t * len)
+{
+    struct stat st;
+    void * addr;
+    int fd;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        printf("Input file not found!\n");
+        exit(1);
+    }
+    if (fstat(fd, &st) < 0 || st.st_size == 0)
+    {
+        printf("Cannot read %s!\n", path);
+        exit(1);
+    }
+
+    addr = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED)
+    {
+        printf("Cannot map %s!\n", path);
+        exit(1);
+    }
+    madvise(addr, st.st_size, MADV_WILLNEED);
+
+    *len = st.st_size;
+    return (unsigned char *)addr;
+}
+
+// Skip whitespace and '#' comments, then read one decimal field
+static int header_field(const unsigned char * buf, size_t len, size_t * pos, int * value)
+{
+    size_t p = *pos;
+    long v = 0;
+
+    while (p < len)
+    {
+        if (buf[p] == '#')
+        {
+            while (p < len && buf[p] != '\n')
+                p++;
+        }
+        else if (buf[p] == ' ' || buf[p] == '\t' || buf[p] == '\n' || buf[p] == '\r')
+        {
+            p++;
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    if (p >= len || buf[p] < '0' || buf[p] > '9')
+        return 0;
+
+    while (p < len && buf[p] >= '0' && buf[p] <= '9' && v <= 0x7fffffff)
+    {
+        v = v * 10 + (buf[p] - '0');
+        p++;
+    }
+
+    *value = (int)v;
+    *pos = p;
+    return 1;
+}
+
+// Parse "P5"/"P6" header; returns the offset of the first pixel
+static size_t parse_header(const unsigned char * buf, size_t len, char magic,
+                           int * w, int * h, int * v_max, const char * path)
+{
+    size_t pos = 2;
+
+    if (len < 2 || buf[0] != 'P' || buf[1] != magic ||
+        !header_field(buf, len, &pos, w) ||
+        !header_field(buf, len, &pos, h) ||
+        !header_field(buf, len, &pos, v_max) ||
+        *w < 1 || *h < 1 || *v_max < 1 || *v_max > 65535 || pos >= len)
+    {
+        printf("%s is not a P%c image!\n", path, magic);
+        exit(1);
+    }
+
+    // The in-memory passes count pixels in int; larger images need --stream
+    if ((long long)*w * *h > INT_MAX)
+    {
+        printf("%s has more than %d pixels, use --stream!\n", path, INT_MAX);
+        exit(1);
+    }
+
+    // Exactly one whitespace byte separates maxval from the pixels
+    return pos + 1;
+}
+
+// The 8-bit readers take maxval <= 255 only; wider samples need the 16-bit
+// readers below
+static void check_8bit(int v_max, const char * path)
+{
+    if (v_max > 255)
+    {
+        printf("%s has 16-bit samples (maxval %d), use the 16-bit path!\n", path, v_max);
+        exit(1);
+    }
+}
+
+// Stream version of header_field; consumes the byte that ends the field
+static int header_field_stream(FILE * in_file, int * value)
+{
+    long v = 0;
+    int c = getc(in_file);
+
+    while (c == '#' || c == ' ' || c == '\t' || c == '\n' || c == '\r')
+    {
+        if (c == '#')
+        {
+            while (c != EOF && c != '\n')
+                c = getc(in_file);
+        }
+        c = getc(in_file);
+    }
+
+    if (c < '0' || c > '9')
+        return 0;
+
+    while (c >= '0' && c <= '9' && v <= 0x7fffffff)
+    {
+        v = v * 10 + (c - '0');
+        c = getc(in_file);
+    }
+
+    *value = (int)v;
+    return 1;
+}
+
+// Stream version of parse_header for readers that do not map the file;
+// leaves the file positioned on the first pixel and returns that offset
+long read_pnm_header(FILE * in_file, char magic, int * w, int * h, int * v_max, const char * path)
+{
+    if (getc(in_file) != 'P' || getc(in_file) != magic ||
+        !header_field_stream(in_file, w) ||
+        !header_field_stream(in_file, h) ||
+        !header_field_stream(in_file, v_max) ||
+        *w < 1 || *h < 1 || *v_max < 1 || *v_max > 65535)
+    {
+        printf("%s is not a P%c image!\n", path, magic);
+        exit(1);
+    }
+
+    return (long)ftello(in_file);
+}
+
+// Remap exactly bytes pixels starting at offset. The mapping starts on the
+// page that holds the first pixel, so unmap_pixels can recover it from the
+// pixel pointer alone.
+static unsigned char * map_pixels(const char * path, size_t offset, size_t bytes)
+{
+    unsigned char * map;
+    size_t page, skip;
+    int fd;
+
+    page = (size_t)sysconf(_SC_PAGESIZE);
+    skip = offset - offset % page;
+    fd = open(path, O_RDONLY);
+    map = (unsigned char *)mmap(NULL, (offset - skip) + bytes,
+                                PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, skip);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        printf("Cannot map %s!\n", path);
+        exit(1);
+    }
+
+    return map + (offset - skip);
+}
+
+static void unmap_pixels(unsigned char * pixels, size_t bytes)
+{
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    unsigned char * base = (unsigned char *)((size_t)pixels - (size_t)pixels % page);
+
+    munmap(base, (pixels - base) + bytes);
+}
+
+PPM_IMG read_ppm(const char * path)
+{
+    PPM_IMG result;
+    unsigned char * map;
+    const unsigned char * ibuf;
+    size_t len, offset;
+    int v_max, img_size;
+    double t0 = prof_now();
+
+    map = map_file(path, &len);
+    offset = parse_header(map, len, '6', &result.w, &result.h, &v_max, path);
+    check_8bit(v_max, path);
+    printf("PPM Image size: %d x %d\n", result.w, result.h);
+
+    if (len - offset < (size_t)3 * result.w * result.h)
+    {
+        printf("%s is truncated!\n", path);
+        exit(1);
+    }
+
+    img_size = result.w * result.h;
+    result.img_r = (unsigned char *)arena_alloc((size_t)img_size);
+    result.img_g = (unsigned char *)arena_alloc((size_t)img_size);
+    result.img_b = (unsigned char *)arena_alloc((size_t)img_size);
+    ibuf = map + offset;
+    prof_add(STAGE_READ, t0, img_size, (long long)len);
+
+    deinterleave_ppm(result, ibuf);
+    munmap(map, len);
+
+    return result;
+}
+
+// Split w * h interleaved pixels into the planes of img, every thread its
+// own thread_range slice
+void deinterleave_ppm(PPM_IMG img, const unsigned char * ibuf)
+{
+    long img_size = (long)img.w * img.h;
+
+    #pragma omp parallel
+    {
+        long start, end;
+        thread_range(img_size, omp_get_thread_num(), omp_get_num_threads(), &start, &end);
+        double t1 = prof_now();
+        long i;
+
+        for(i = start; i < end; i ++)
+        {
+            img.img_r[i] = ibuf[3*i + 0];
+            img.img_g[i] = ibuf[3*i + 1];
+            img.img_b[i] = ibuf[3*i + 2];
+        }
+        prof_add(STAGE_DEINTERLEAVE, t1, end - start, 6 * (end - start));
+    }
+}
+
+// Zero-copy PPM: the interleaved pixels stay in a private mapping of the
+// file. Release with unmap_rgb, not free_rgb.
+RGB_IMG map_rgb(const char * path)
+{
+    RGB_IMG result;
+    unsigned char * map;
+    size_t len, offset;
+    int v_max;
+    double t0 = prof_now();
+
+    map = map_file(path, &len);
+    offset = parse_header(map, len, '6', &result.w, &result.h, &v_max, path);
+    check_8bit(v_max, path);
+    printf("PPM Image size: %d x %d\n", result.w, result.h);
+
+    if (len - offset < (size_t)3 * result.w * result.h)
+    {
+        printf("%s is truncated!\n", path);
+        exit(1);
+    }
+    munmap(map, len);
+
+    result.img = map_pixels(path, offset, (size_t)3 * result.w * result.h);
+    prof_add(STAGE_READ, t0, (long long)result.w * result.h, 3LL * result.w * result.h);
+    return result;
+}
+
+void unmap_rgb(RGB_IMG img)
+{
+    unmap_pixels(img.img, (size_t)3 * img.w * img.h);
+}
+
+// Packed pixels already have the file layout, so they are written as is
+void write_rgb(RGB_IMG img, const char * path)
+{
+    FILE * out_file;
+    double t0 = prof_now();
+
+    out_file = fopen(path, "wb");
+    fprintf(out_file, "P6\n");
+    fprintf(out_file, "%d %d\n255\n",img.w, img.h);
+    fwrite(img.img,sizeof(unsigned char), (size_t)3*img.w*img.h, out_file);
+    fclose(out_file);
+    prof_add(STAGE_WRITE, t0, (long long)img.w * img.h, 3LL * img.w * img.h);
+}
+
+void free_rgb(RGB_IMG img)
+{
+    arena_free(img.img);
+}
+
+void write_ppm(PPM_IMG img, const char * path)
+{
+    FILE * out_file;
+    double t0;
+
+    unsigned char * obuf = (unsigned char *)arena_alloc((size_t)3 * img.w * img.h);
+
+    interleave_ppm(obuf, img);
+
+    t0 = prof_now();
+    out_file = fopen(path, "wb");
+    fprintf(out_file, "P6\n");
+    fprintf(out_file, "%d %d\n255\n",img.w, img.h);
+    fwrite(obuf,sizeof(unsigned char), (size_t)3 * img.w * img.h, out_file);
+    fclose(out_file);
+    prof_add(STAGE_WRITE, t0, (long long)img.w * img.h, 3LL * img.w * img.h);
+    arena_free(obuf);
+}
+
+// Join the planes of img into w * h interleaved pixels; every thread
+// interleaves the slice of the planes it wrote
+void interleave_ppm(unsigned char * obuf, PPM_IMG img)
+{
+    long img_size = (long)img.w * img.h;
+
+    #pragma omp parallel
+    {
+        long start, end;
+        thread_range(img_size, omp_get_thread_num(), omp_get_num_threads(), &start, &end);
+        double t1 = prof_now();
+        long i;
+
+        for(i = start; i < end; i++)
+        {
+            obuf[3*i + 0] = img.img_r[i];
+            obuf[3*i + 1] = img.img_g[i];
+            obuf[3*i + 2] = img.img_b[i];
+        }
+        prof_add(STAGE_INTERLEAVE, t1, end - start, 6 * (end - start));
+    }
+}
+
+void free_ppm(PPM_IMG img)
+{
+    arena_free(img.img_r);
+    arena_free(img.img_g);
+    arena_free(img.img_b);
+}
+
+PGM_IMG read_pgm(const char * path)
+{
+    PGM_IMG result;
+    unsigned char * map;
+    size_t len, offset;
+    int v_max, img_size;
+    double t0 = prof_now();
+
+    map = map_file(path, &len);
+    offset = parse_header(map, len, '5', &result.w, &result.h, &v_max, path);
+    check_8bit(v_max, path);
+    printf("PGM Image size: %d x %d\n", result.w, result.h);
+
+    if (len - offset < (size_t)result.w * result.h)
+    {
+        printf("%s is truncated!\n", path);
+        exit(1);
+    }
+
+    img_size = result.w * result.h;
+    result.img = (unsigned char *)arena_alloc((size_t)img_size);
+
+    // Every thread copies (and first-touches) its own static slice
+    #pragma omp parallel
+    {
+        long start, end;
+        thread_range((long)img_size, omp_get_thread_num(), omp_get_num_threads(), &start, &end);
+
+        memcpy(result.img + start, map + offset + start, end - start);
+    }
+
+    munmap(map, len);
+    prof_add(STAGE_READ, t0, img_size, (long long)len + img_size);
+
+    return result;
+}
+
+// Zero-copy PGM: img points into a private mapping of the file.
+// Release with unmap_pgm, not free_pgm.
+PGM_IMG map_pgm(const char * path)
+{
+    PGM_IMG result;
+    unsigned char * map;
+    size_t len, offset;
+    int v_max;
+    double t0 = prof_now();
+
+    map = map_file(path, &len);
+    offset = parse_header(map, len, '5', &result.w, &result.h, &v_max, path);
+    check_8bit(v_max, path);
+    printf("PGM Image size: %d x %d\n", result.w, result.h);
+
+    if (len - offset < (size_t)result.w * result.h)
+    {
+        printf("%s is truncated!\n", path);
+        exit(1);
+    }
+    munmap(map, len);
+
+    result.img = map_pixels(path, offset, (size_t)result.w * result.h);
+    prof_add(STAGE_READ, t0, (long long)result.w * result.h, (long long)result.w * result.h);
+    return result;
+}
+
+void unmap_pgm(PGM_IMG img)
+{
+    unmap_pixels(img.img, (size_t)img.w * img.h);
+}
+
+void write_pgm(PGM_IMG img, const char * path)
+{
+    FILE * out_file;
+    double t0 = prof_now();
+
+    out_file = fopen(path, "wb");
+    fprintf(out_file, "P5\n");
+    fprintf(out_file, "%d %d\n255\n",img.w, img.h);
+    fwrite(img.img,sizeof(unsigned char), (size_t)img.w * img.h, out_file);
+    fclose(out_file);
+    prof_add(STAGE_WRITE, t0, (long long)img.w * img.h, (long long)img.w * img.h);
+}
+
+void free_pgm(PGM_IMG img)
+{
+    arena_free(img.img);
+}
+
+// 16-bit images. Samples are big-endian in the file when maxval > 255 and
+// single bytes otherwise; both are read into 16-bit planes and written back
+// in the same format.
+
+// Sample of index i from the file data, clamped to maxval so it always
+// indexes a histogram bin
+static inline unsigned short sample16(const unsigned char * buf, long i, int wide, int v_max)
+{
+    int v = wide ? ((buf[2*i] << 8) | buf[2*i + 1]) : buf[i];
+
+    return (unsigned short)((v > v_max) ? v_max : v);
+}
+
+static void write_samples16(FILE * out_file, const unsigned short * const * planes, int channels,
+                            long img_size, int v_max)
+{
+    int wide = (v_max > 255);
+    size_t bytes = (size_t)img_size * channels * (wide ? 2 : 1);
+    unsigned char * obuf = (unsigned char *)arena_alloc(bytes);
+
+    // Every thread packs the slice of the planes it wrote
+    #pragma omp parallel
+    {
+        long start, end, i;
+        int c;
+        thread_range(img_size, omp_get_thread_num(), omp_get_num_threads(), &start, &end);
+
+        for (i = start; i < end; i++)
+        {
+            for (c = 0; c < channels; c++)
+            {
+                unsigned short v = planes[c][i];
+                long k = i * channels + c;
+
+                if (wide)
+                {
+                    obuf[2*k] = (unsigned char)(v >> 8);
+                    obuf[2*k + 1] = (unsigned char)v;
+                }
+                else
+                {
+                    obuf[k] = (unsigned char)v;
+                }
+            }
+        }
+    }
+
+    fwrite(obuf, 1, bytes, out_file);
+    arena_free(obuf);
+}
+
+PGM16_IMG read_pgm16(const char * path)
+{
+    PGM16_IMG result;
+    unsigned char * map;
+    const unsigned char * ibuf;
+    size_t len, offset;
+    long img_size;
+    int wide;
+    double t0 = prof_now();
+
+    map = map_file(path, &len);
+    offset = parse_header(map, len, '5', &result.w, &result.h, &result.v_max, path);
+    printf("PGM Image size: %d x %d, maxval %d\n", result.w, result.h, result.v_max);
+
+    wide = (result.v_max > 255);
+    img_size = (long)result.w * result.h;
+    if (len - offset < (size_t)img_size * (wide ? 2 : 1))
+    {
+        printf("%s is truncated!\n", path);
+        exit(1);
+    }
+
+    result.img = (unsigned short *)arena_alloc(img_size * sizeof(unsigned short));
+    ibuf = map + offset;
+
+    // First touch of each page of the plane by the thread that processes it
+    #pragma omp parallel
+    {
+        long start, end, i;
+        thread_range(img_size, omp_get_thread_num(), omp_get_num_threads(), &start, &end);
+
+        for (i = start; i < end; i++)
+        {
+            result.img[i] = sample16(ibuf, i, wide, result.v_max);
+        }
+    }
+
+    munmap(map, len);
+    prof_add(STAGE_READ, t0, img_size, (long long)len);
+
+    return result;
+}
+
+void write_pgm16(PGM16_IMG img, const char * path)
+{
+    FILE * out_file;
+    const unsigned short * planes[1] = {img.img};
+    double t0 = prof_now();
+
+    out_file = fopen(path, "wb");
+    fprintf(out_file, "P5\n");
+    fprintf(out_file, "%d %d\n%d\n", img.w, img.h, img.v_max);
+    write_samples16(out_file, planes, 1, (long)img.w * img.h, img.v_max);
+    fclose(out_file);
+    prof_add(STAGE_WRITE, t0, (long long)img.w * img.h, (long long)img.w * img.h * (img.v_max > 255 ? 2 : 1));
+}
+
+void free_pgm16(PGM16_IMG img)
+{
+    arena_free(img.img);
+}
+
+PPM16_IMG read_ppm16(const char * path)
+{
+    PPM16_IMG result;
+    unsigned char * map;
+    const unsigned char * ibuf;
+    size_t len, offset;
+    long img_size;
+    int wide;
+    double t0 = prof_now();
+
+    map = map_file(path, &len);
+    offset = parse_header(map, len, '6', &result.w, &result.h, &result.v_max, path);
+    printf("PPM Image size: %d x %d, maxval %d\n", result.w, result.h, result.v_max);
+
+    wide = (result.v_max > 255);
+    img_size = (long)result.w * result.h;
+    if (len - offset < (size_t)3 * img_size * (wide ? 2 : 1))
+    {
+        printf("%s is truncated!\n", path);
+        exit(1);
+    }
+
+    result.img_r = (unsigned short *)arena_alloc(img_size * sizeof(unsigned short));
+    result.img_g = (unsigned short *)arena_alloc(img_size * sizeof(unsigned short));
+    result.img_b = (unsigned short *)arena_alloc(img_size * sizeof(unsigned short));
+    ibuf = map + offset;
+
+    #pragma omp parallel
+    {
+        long start, end, i;
+        thread_range(img_size, omp_get_thread_num(), omp_get_num_threads(), &start, &end);
+
+        for (i = start; i < end; i++)
+        {
+            result.img_r[i] = sample16(ibuf, 3*i + 0, wide, result.v_max);
+            result.img_g[i] = sample16(ibuf, 3*i + 1, wide, result.v_max);
+            result.img_b[i] = sample16(ibuf, 3*i + 2, wide, result.v_max);
+        }
+    }
+
+    munmap(map, len);
+    prof_add(STAGE_READ, t0, img_size, (long long)len);
+
+    return result;
+}
+
+void write_ppm16(PPM16_IMG img, const char * path)
+{
+    FILE * out_file;
+    const unsigned short * planes[3] = {img.img_r, img.img_g, img.img_b};
+    double t0 = prof_now();
+
+    out_file = fopen(path, "wb");
+    fprintf(out_file, "P6\n");
+    fprintf(out_file, "%d %d\n%d\n", img.w, img.h, img.v_max);
+    write_samples16(out_file, planes, 3, (long)img.w * img.h, img.v_max);
+    fclose(out_file);
+    prof_add(STAGE_WRITE, t0, (long long)img.w * img.h, (long long)img.w * img.h * 3 * (img.v_max > 255 ? 2 : 1));
+}
+
+void free_ppm16(PPM16_IMG img)
+{
+    arena_free(img.img_r);
+    arena_free(img.img_g);
+    arena_free(img.img_b);
+}
+
+// maxval of a PGM ('5') or PPM ('6') file, to pick the 8- or 16-bit path
+int read_pnm_maxval(const char * path, char magic)
+{
+    unsigned char * map;
+    size_t len;
+    int w, h, v_max;
+
+    map = map_file(path, &len);
+    parse_header(map, len, magic, &w, &h, &v_max, path);
+    munmap(map, len);
+
+    return v_max;
+}
@@ -0,0 +1,802 @@
+#ifdef HIST_MPI
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "hist-equ.h"
+#include <mpi.h>
+#include <omp.h>
+
+// MPI executors. Every rank reads its own block of rows straight from the
+// file with collective MPI-IO, enhances it with one OpenMP thread (mpi) or
+// OMP_NUM_THREADS threads (hybrid), and
+// writes the enhanced block at its place in the output file, again with
+// collective MPI-IO; rank 0 also writes the header. The LUT is built from
+// the histograms of all blocks, summed with MPI_Allreduce. With
+// HIST_MPI_IO=0 rank 0 reads the whole image instead and scatters the
+// blocks, then gathers the enhanced blocks and writes the output alone, which is slower but works
+// on file systems without MPI-IO support.
+//
+// The image is split into blocks of whole rows, which every rank computes
+// from the width and height alone (see split_image), so a part is a real
+// w x rows image and the only setup message is the broadcast of the
+// header. HIST_MPI_ROWS=G hands out rows in units of G rows, and
+// HIST_MPI_WEIGHTS=a,b,... gives rank r a share of the rows proportional to
+// its integer weight (1 for ranks not listed), for ranks on slower nodes.
+//
+// With HIST_MPI_NODE=1 the ranks that share memory form a node. Each node
+// holds the input image in an MPI shared window, every rank reads its rows
+// into the window and enhances them in place, and with HIST_MPI_IO=0 rank 0
+// sends the image once per node, to the node leaders, instead of once per
+// rank. Histograms are summed within the node first, then across the
+// leaders only, and the result is broadcast within the node.
+
+static const int root = 0; // Root process
+
+static int rank, size;
+static int * sendcounts;   // pixels of every rank
+static int * displs;       // first pixel of every rank
+static int * weights;
+static int row_grain;
+static int img_w, img_h;   // image being split
+static int use_mpi_io;
+
+// Node-aware mode
+#define NODE_WINDOWS 4
+
+typedef struct
+{
+    unsigned char * base;
+    MPI_Aint bytes;
+    MPI_Win win;
+} NODE_WINDOW;
+
+static int node_aware;
+static MPI_Comm node_comm = MPI_COMM_NULL;    // ranks of this node
+static MPI_Comm leader_comm = MPI_COMM_NULL;  // first rank of every node
+static int node_rank;
+static NODE_WINDOW node_windows[NODE_WINDOWS];
+
+// Rows per unit and rank weights from the environment; every rank parses
+// the same values, so a bad value stops them all
+static void read_split_options(void)
+{
+    const char * env = getenv("HIST_MPI_ROWS");
+    const char * p;
+    char * end;
+    int r;
+
+    row_grain = (env != NULL) ? atoi(env) : 1;
+    if (row_grain < 1)
+    {
+        if (rank == root)
+            printf("HIST_MPI_ROWS must be a positive number of rows!\n");
+        exit(1);
+    }
+
+    for (r = 0; r < size; r++)
+    {
+        weights[r] = 1;
+    }
+    p = getenv("HIST_MPI_WEIGHTS");
+    for (r = 0; p != NULL && *p != '\0' && r < size; r++)
+    {
+        weights[r] = (int)strtol(p, &end, 10);
+        if (end == p || weights[r] < 1)
+        {
+            if (rank == root)
+                printf("HIST_MPI_WEIGHTS must list positive integers, one per rank!\n");
+            exit(1);
+        }
+        p = (*end == ',') ? end + 1 : end;
+    }
+}
+
+// exit() before MPI_Finalize, like the root stopping on a malformed input
+// that the shared readers reject, would leave the other ranks waiting in a
+// collective; abort the whole job instead
+static void mpi_exit(void)
+{
+    int finalized;
+
+    MPI_Finalized(&finalized);
+    if (!finalized)
+        MPI_Abort(MPI_COMM_WORLD, 1);
+}
+
+// Only the thread that called MPI_Init_thread makes MPI calls: histograms
+// are reduced and parts exchanged between the parallel regions
+static void mpi_start(int * argc, char *** argv)
+{
+    int namelen, provided;
+    char processor_name[MPI_MAX_PROCESSOR_NAME];
+
+    MPI_Init_thread(argc, argv, MPI_THREAD_FUNNELED, &provided); // Init MPI application
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank); // Who am I
+    MPI_Comm_size(MPI_COMM_WORLD, &size); // How many processes
+    atexit(mpi_exit);
+    MPI_Get_processor_name(processor_name, &namelen); // Get processor name
+
+    if (provided < MPI_THREAD_FUNNELED && rank == root)
+        printf("The MPI library does not support threads, running with one thread per rank.\n");
+    if (provided < MPI_THREAD_FUNNELED)
+        omp_set_num_threads(1);
+
+    fprintf(stderr, "Process %d of %d on %s, %d threads\n", rank, size, processor_name,
+            omp_get_max_threads());
+
+    backend_set_process(rank, size);
+    use_mpi_io = (getenv("HIST_MPI_IO") == NULL || atoi(getenv("HIST_MPI_IO")) != 0);
+    sendcounts = (int *)malloc(sizeof(int) * size);
+    displs = (int *)malloc(sizeof(int) * size);
+    weights = (int *)malloc(sizeof(int) * size);
+    read_split_options();
+
+    node_aware = (getenv("HIST_MPI_NODE") != NULL && atoi(getenv("HIST_MPI_NODE")) != 0);
+    if (node_aware)
+    {
+        int nnodes;
+
+        // Keyed by rank, so world rank 0 is rank 0 of its node and of the leaders
+        MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &node_comm);
+        MPI_Comm_rank(node_comm, &node_rank);
+        MPI_Comm_split(MPI_COMM_WORLD, (node_rank == 0) ? 0 : MPI_UNDEFINED, rank, &leader_comm);
+        if (rank == root)
+        {
+            MPI_Comm_size(leader_comm, &nnodes);
+            printf("Node-aware MPI: %d node(s)\n", nnodes);
+        }
+    }
+}
+
+static void mpi_init(int * argc, char *** argv)
+{
+    // One process per core
+    omp_set_dynamic(0);
+    omp_set_num_threads(1);
+    mpi_start(argc, argv);
+}
+
+// One process per node or socket, each running the threaded kernels over
+// its part with OMP_NUM_THREADS threads
+static void hybrid_init(int * argc, char *** argv)
+{
+    omp_set_dynamic(0);
+    mpi_start(argc, argv);
+}
+
+static void mpi_finalize(void)
+{
+    free(sendcounts);
+    free(displs);
+    free(weights);
+    if (leader_comm != MPI_COMM_NULL)
+        MPI_Comm_free(&leader_comm);
+    if (node_comm != MPI_COMM_NULL)
+        MPI_Comm_free(&node_comm);
+    MPI_Finalize(); // End the MPI application (mandatory)
+}
+
+// Row blocks of a w x h image, the same on every rank without any message.
+// The ceil(h / row_grain) units are handed out in rank order, rank r taking
+// units [units * W(r) / W, units * W(r + 1) / W) where W(r) is the sum of
+// the weights of the ranks before r; with equal weights the ranks differ by
+// at most one unit. The last unit may be short.
+static void split_image(int w, int h)
+{
+    long long units = (h + row_grain - 1) / row_grain;
+    long long total = 0, before = 0;
+    long long first, last;
+    int r;
+
+    for (r = 0; r < size; r++)
+    {
+        total += weights[r];
+    }
+    for (r = 0; r < size; r++)
+    {
+        first = units * before / total * row_grain;
+        before += weights[r];
+        last = units * before / total * row_grain;
+        if (first > h)
+            first = h;
+        if (last > h)
+            last = h;
+        sendcounts[r] = (int)((last - first) * w);
+        displs[r] = (int)(first * w);
+    }
+
+    img_w = w;
+    img_h = h;
+}
+
+// Rows of this rank's part
+static int part_rows(void)
+{
+    return (img_w > 0) ? sendcounts[rank] / img_w : 0;
+}
+
+static void scatter_plane(unsigned char * part, const unsigned char * plane)
+{
+    MPI_Scatterv(plane, sendcounts, displs, MPI_UNSIGNED_CHAR, part,
+                 sendcounts[rank], MPI_UNSIGNED_CHAR, root, MPI_COMM_WORLD);
+}
+
+static void gather_plane(unsigned char * plane, const unsigned char * part)
+{
+    MPI_Gatherv(part, sendcounts[rank], MPI_UNSIGNED_CHAR, plane,
+                sendcounts, displs, MPI_UNSIGNED_CHAR, root, MPI_COMM_WORLD);
+}
+
+// Size of the image the root read, in one broadcast
+static void share_size(int * w, int * h)
+{
+    int dims[2] = { *w, *h };
+
+    MPI_Bcast(dims, 2, MPI_INT, root, MPI_COMM_WORLD);
+    *w = dims[0];
+    *h = dims[1];
+}
+
+// Root reads the whole image and hands out the row blocks
+static PGM_IMG mpi_scatter_pgm(PGM_IMG img)
+{
+    PGM_IMG part;
+    double t0;
+
+    share_size(&img.w, &img.h);
+    split_image(img.w, img.h);
+    part.w = img_w;
+    part.h = part_rows();
+    part.img = (unsigned char *)arena_alloc(sendcounts[rank]);
+
+    // Divide the data among processes as described by sendcounts and displacements
+    t0 = prof_now();
+    scatter_plane(part.img, img.img);
+    prof_add(STAGE_SCATTER, t0, sendcounts[rank], sendcounts[rank]);
+
+    return part;
+}
+
+// The whole image is only allocated on the root
+static PGM_IMG mpi_gather_pgm(PGM_IMG part)
+{
+    PGM_IMG img;
+    double t0;
+
+    img.w = img_w;
+    img.h = img_h;
+    img.img = (rank == root) ? (unsigned char *)arena_alloc(img_w * img_h) : NULL;
+
+    // Gathers into specified locations from all processes in a group
+    t0 = prof_now();
+    gather_plane(img.img, part.img);
+    prof_add(STAGE_GATHER, t0, sendcounts[rank], sendcounts[rank]);
+
+    return img;
+}
+
+static PPM_IMG mpi_scatter_ppm(PPM_IMG img)
+{
+    PPM_IMG part;
+    double t0;
+
+    share_size(&img.w, &img.h);
+    split_image(img.w, img.h);
+    part.w = img_w;
+    part.h = part_rows();
+    part.img_r = (unsigned char *)arena_alloc(sendcounts[rank]);
+    part.img_g = (unsigned char *)arena_alloc(sendcounts[rank]);
+    part.img_b = (unsigned char *)arena_alloc(sendcounts[rank]);
+
+    t0 = prof_now();
+    scatter_plane(part.img_r, img.img_r);
+    scatter_plane(part.img_g, img.img_g);
+    scatter_plane(part.img_b, img.img_b);
+    prof_add(STAGE_SCATTER, t0, sendcounts[rank], 3LL * sendcounts[rank]);
+
+    return part;
+}
+
+static PPM_IMG mpi_gather_ppm(PPM_IMG part)
+{
+    PPM_IMG img;
+    double t0;
+
+    img.w = img_w;
+    img.h = img_h;
+    img.img_r = img.img_g = img.img_b = NULL;
+    if (rank == root)
+    {
+        img.img_r = (unsigned char *)arena_alloc(img_w * img_h);
+        img.img_g = (unsigned char *)arena_alloc(img_w * img_h);
+        img.img_b = (unsigned char *)arena_alloc(img_w * img_h);
+    }
+
+    t0 = prof_now();
+    gather_plane(img.img_r, part.img_r);
+    gather_plane(img.img_g, part.img_g);
+    gather_plane(img.img_b, part.img_b);
+    prof_add(STAGE_GATHER, t0, sendcounts[rank], 3LL * sendcounts[rank]);
+
+    return img;
+}
+
+// Width, height and pixel offset of a P5/P6 file, from the header parsed on
+// the root; an unreadable, malformed or 16-bit file stops every rank
+static MPI_Offset read_header(const char * path, char magic, int * w, int * h)
+{
+    long header[3] = { 0, 0, 0 };   // w, h, offset
+    FILE * in_file;
+    int v_max, cw, ch;
+
+    if (rank == root)
+    {
+        in_file = fopen(path, "rb");
+        if (in_file == NULL)
+        {
+            printf("Cannot open %s!\n", path);
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        header[2] = read_pnm_header(in_file, magic, &cw, &ch, &v_max, path);
+        fclose(in_file);
+        if (v_max > 255)
+        {
+            printf("%s has 16-bit samples, which need the serial or openmp backend!\n", path);
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        printf("%s Image size: %d x %d\n", (magic == '5') ? "PGM" : "PPM", cw, ch);
+        header[0] = cw;
+        header[1] = ch;
+    }
+
+    MPI_Bcast(header, 3, MPI_LONG, root, MPI_COMM_WORLD);
+    *w = (int)header[0];
+    *h = (int)header[1];
+    return (MPI_Offset)header[2];
+}
+
+// Every rank reads the bytes of its own run, pixel_bytes per pixel, with
+// one collective call so the MPI library can merge the requests
+static void read_run(const char * path, MPI_Offset offset, int pixel_bytes, unsigned char * buf)
+{
+    MPI_Datatype pixel;
+    MPI_File fh;
+    MPI_Offset size;
+    MPI_Status status;
+    double t0 = prof_now();
+
+    if (MPI_File_open(MPI_COMM_WORLD, path, MPI_MODE_RDONLY, MPI_INFO_NULL, &fh) != MPI_SUCCESS)
+    {
+        if (rank == root)
+            printf("Cannot open %s!\n", path);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    MPI_File_get_size(fh, &size);
+    if (size - offset < (MPI_Offset)pixel_bytes * img_w * img_h)
+    {
+        if (rank == root)
+            printf("%s is truncated!\n", path);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    // Counts in whole pixels keep a run of up to 2^31 pixels in one int
+    MPI_Type_contiguous(pixel_bytes, MPI_UNSIGNED_CHAR, &pixel);
+    MPI_Type_commit(&pixel);
+    MPI_File_read_at_all(fh, offset + (MPI_Offset)pixel_bytes * displs[rank], buf,
+                         sendcounts[rank], pixel, &status);
+    MPI_Type_free(&pixel);
+    MPI_File_close(&fh);
+
+    prof_add(STAGE_READ, t0, sendcounts[rank], (long long)pixel_bytes * sendcounts[rank]);
+}
+
+// MPI-IO fills a buffer from the calling thread alone. With HIST_PIN the
+// threads of the rank fault in their own slices of the part first, so its
+// pages sit on their nodes; color parts get the same from deinterleave_ppm.
+static void touch_part(unsigned char * buf, long n)
+{
+    if (!placement_enabled())
+        return;
+
+    #pragma omp parallel
+    {
+        long start, end;
+        thread_range(n, omp_get_thread_num(), omp_get_num_threads(), &start, &end);
+
+        memset(buf + start, 0, end - start);
+    }
+}
+
+// A window of bytes shared by the ranks of this node, allocated by the
+// node leader and mapped by the others; stays open for load/store access
+// until node_free
+static unsigned char * node_alloc(MPI_Aint bytes)
+{
+    NODE_WINDOW * nw = NULL;
+    MPI_Aint wsize;
+    int disp, i;
+
+    for (i = 0; i < NODE_WINDOWS; i++)
+    {
+        if (node_windows[i].base == NULL)
+        {
+            nw = &node_windows[i];
+            break;
+        }
+    }
+    if (nw == NULL)
+    {
+        printf("Too many shared windows!\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    MPI_Win_allocate_shared((node_rank == 0) ? bytes : 0, 1, MPI_INFO_NULL, node_comm,
+                            &nw->base, &nw->win);
+    MPI_Win_shared_query(nw->win, 0, &wsize, &disp, &nw->base);
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, nw->win);
+    nw->bytes = bytes;
+
+    return nw->base;
+}
+
+static NODE_WINDOW * node_find(const unsigned char * ptr)
+{
+    int i;
+
+    for (i = 0; i < NODE_WINDOWS; i++)
+    {
+        if (node_windows[i].base != NULL && ptr >= node_windows[i].base &&
+            ptr < node_windows[i].base + node_windows[i].bytes)
+            return &node_windows[i];
+    }
+    return NULL;
+}
+
+// Make the stores of every rank of the node to a window visible to all
+static void node_sync(const unsigned char * base)
+{
+    NODE_WINDOW * nw = node_find(base);
+
+    MPI_Win_sync(nw->win);
+    MPI_Barrier(node_comm);
+    MPI_Win_sync(nw->win);
+}
+
+static void node_free(NODE_WINDOW * nw)
+{
+    MPI_Win_unlock_all(nw->win);
+    MPI_Win_free(&nw->win);
+    nw->base = NULL;
+}
+
+// The whole image read by the root goes to every node leader, as rows so
+// that images above 2 GB still fit the int count
+static void node_broadcast(unsigned char * base, int rows)
+{
+    MPI_Datatype row;
+    double t0 = prof_now();
+
+    if (leader_comm == MPI_COMM_NULL)
+        return;
+    MPI_Type_contiguous(img_w, MPI_UNSIGNED_CHAR, &row);
+    MPI_Type_commit(&row);
+    MPI_Bcast(base, rows, row, 0, leader_comm);
+    MPI_Type_free(&row);
+    prof_add(STAGE_SCATTER, t0, (long long)img_w * img_h, (long long)img_w * rows);
+}
+
+// Node-aware read: the rows of every rank land in the node's window, and
+// the part points at them
+static PGM_IMG node_read_pgm(const char * path)
+{
+    PGM_IMG img, part;
+    MPI_Offset offset = 0;
+    unsigned char * base;
+    int w, h;
+
+    memset(&img, 0, sizeof(img));
+    if (use_mpi_io)
+    {
+        offset = read_header(path, '5', &w, &h);
+    }
+    else
+    {
+        if (rank == root)
+            img = read_pgm(path);
+        w = img.w;
+        h = img.h;
+        share_size(&w, &h);
+    }
+    split_image(w, h);
+    base = node_alloc((MPI_Aint)w * h);
+
+    if (use_mpi_io)
+    {
+        read_run(path, offset, 1, base + displs[rank]);
+    }
+    else
+    {
+        if (rank == root)
+        {
+            memcpy(base, img.img, (size_t)w * h);
+            free_pgm(img);
+        }
+        node_broadcast(base, h);
+    }
+    node_sync(base);
+
+    part.w = img_w;
+    part.h = part_rows();
+    part.img = base + displs[rank];
+    return part;
+}
+
+// Planes R, G and B one after the other in the window
+static PPM_IMG node_read_ppm(const char * path)
+{
+    PPM_IMG img, part;
+    MPI_Offset offset = 0;
+    unsigned char * base;
+    unsigned char * ibuf;
+    size_t n;
+    int w, h;
+
+    memset(&img, 0, sizeof(img));
+    if (use_mpi_io)
+    {
+        offset = read_header(path, '6', &w, &h);
+    }
+    else
+    {
+        if (rank == root)
+            img = read_ppm(path);
+        w = img.w;
+        h = img.h;
+        share_size(&w, &h);
+    }
+    split_image(w, h);
+    n = (size_t)w * h;
+    base = node_alloc(3 * (MPI_Aint)n);
+
+    part.w = img_w;
+    part.h = part_rows();
+    part.img_r = base + displs[rank];
+    part.img_g = base + n + displs[rank];
+    part.img_b = base + 2 * n + displs[rank];
+
+    if (use_mpi_io)
+    {
+        ibuf = (unsigned char *)arena_alloc(3 * (size_t)sendcounts[rank]);
+        read_run(path, offset, 3, ibuf);
+        deinterleave_ppm(part, ibuf);
+        arena_free(ibuf);
+    }
+    else
+    {
+        if (rank == root)
+        {
+            memcpy(base, img.img_r, n);
+            memcpy(base + n, img.img_g, n);
+            memcpy(base + 2 * n, img.img_b, n);
+            free_ppm(img);
+        }
+        node_broadcast(base, 3 * h);
+    }
+    node_sync(base);
+
+    return part;
+}
+
+static PGM_IMG mpi_read_pgm(const char * path)
+{
+    PGM_IMG img, part;
+    MPI_Offset offset;
+    int w, h;
+
+    if (node_aware)
+        return node_read_pgm(path);
+
+    if (!use_mpi_io)
+    {
+        memset(&img, 0, sizeof(img));
+        if (rank == root)
+            img = read_pgm(path);
+        part = mpi_scatter_pgm(img);
+        if (rank == root)
+            free_pgm(img);
+        return part;
+    }
+
+    offset = read_header(path, '5', &w, &h);
+    split_image(w, h);
+    part.w = img_w;
+    part.h = part_rows();
+    part.img = (unsigned char *)arena_alloc(sendcounts[rank]);
+    touch_part(part.img, sendcounts[rank]);
+    read_run(path, offset, 1, part.img);
+
+    return part;
+}
+
+// The interleaved run is read into scratch and split into the planes here
+static PPM_IMG mpi_read_ppm(const char * path)
+{
+    PPM_IMG img, part;
+    MPI_Offset offset;
+    unsigned char * ibuf;
+    int w, h;
+
+    if (node_aware)
+        return node_read_ppm(path);
+
+    if (!use_mpi_io)
+    {
+        memset(&img, 0, sizeof(img));
+        if (rank == root)
+            img = read_ppm(path);
+        part = mpi_scatter_ppm(img);
+        if (rank == root)
+            free_ppm(img);
+        return part;
+    }
+
+    offset = read_header(path, '6', &w, &h);
+    split_image(w, h);
+    part.w = img_w;
+    part.h = part_rows();
+    part.img_r = (unsigned char *)arena_alloc(sendcounts[rank]);
+    part.img_g = (unsigned char *)arena_alloc(sendcounts[rank]);
+    part.img_b = (unsigned char *)arena_alloc(sendcounts[rank]);
+
+    ibuf = (unsigned char *)arena_alloc(3 * (size_t)sendcounts[rank]);
+    read_run(path, offset, 3, ibuf);
+    deinterleave_ppm(part, ibuf);
+    arena_free(ibuf);
+
+    return part;
+}
+
+// Parts in a node window are released with the window, by all ranks of
+// the node together
+static void mpi_free_pgm(PGM_IMG part)
+{
+    NODE_WINDOW * nw = node_aware ? node_find(part.img) : NULL;
+
+    if (nw != NULL)
+        node_free(nw);
+    else
+        free_pgm(part);
+}
+
+static void mpi_free_ppm(PPM_IMG part)
+{
+    NODE_WINDOW * nw = node_aware ? node_find(part.img_r) : NULL;
+
+    if (nw != NULL)
+        node_free(nw);
+    else
+        free_ppm(part);
+}
+
+// Rank 0 writes the header and every rank its own run after it, with one
+// collective call. The file is cut to its final size first, in case an
+// older and larger file of the same name is overwritten.
+static void write_run(const char * path, char magic, int pixel_bytes, const unsigned char * buf)
+{
+    char header[64];
+    int header_len = snprintf(header, sizeof(header), "P%c\n%d %d\n255\n", magic, img_w, img_h);
+    MPI_Datatype pixel;
+    MPI_File fh;
+    MPI_Status status;
+    double t0 = prof_now();
+
+    if (MPI_File_open(MPI_COMM_WORLD, path, MPI_MODE_CREATE | MPI_MODE_WRONLY,
+                      MPI_INFO_NULL, &fh) != MPI_SUCCESS)
+    {
+        if (rank == root)
+            printf("Cannot write %s!\n", path);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    MPI_File_set_size(fh, header_len + (MPI_Offset)pixel_bytes * img_w * img_h);
+    if (rank == root)
+        MPI_File_write_at(fh, 0, header, header_len, MPI_CHAR, &status);
+
+    MPI_Type_contiguous(pixel_bytes, MPI_UNSIGNED_CHAR, &pixel);
+    MPI_Type_commit(&pixel);
+    MPI_File_write_at_all(fh, header_len + (MPI_Offset)pixel_bytes * displs[rank], buf,
+                          sendcounts[rank], pixel, &status);
+    MPI_Type_free(&pixel);
+    MPI_File_close(&fh);
+
+    prof_add(STAGE_WRITE, t0, sendcounts[rank], (long long)pixel_bytes * sendcounts[rank]);
+}
+
+static void mpi_write_pgm(PGM_IMG part, const char * path)
+{
+    PGM_IMG img;
+
+    if (!use_mpi_io)
+    {
+        img = mpi_gather_pgm(part);
+        if (rank == root)
+            write_pgm(img, path);
+        free_pgm(img);
+        return;
+    }
+
+    write_run(path, '5', 1, part.img);
+}
+
+// The run is interleaved into scratch here, so no rank ever holds more
+// than its own part of the output
+static void mpi_write_ppm(PPM_IMG part, const char * path)
+{
+    PPM_IMG img;
+    unsigned char * obuf;
+
+    if (!use_mpi_io)
+    {
+        img = mpi_gather_ppm(part);
+        if (rank == root)
+            write_ppm(img, path);
+        free_ppm(img);
+        return;
+    }
+
+    obuf = (unsigned char *)arena_alloc(3 * (size_t)sendcounts[rank]);
+    interleave_ppm(obuf, part);
+    write_run(path, '6', 3, obuf);
+    arena_free(obuf);
+}
+
+// Histogram and pixel count in one message, as nbr_bin + 1 counters
+static void mpi_reduce_histogram(long long * hist, int nbr_bin, long long * img_size)
+{
+    long long * buf = (long long *)arena_alloc((nbr_bin + 1) * sizeof(long long));
+    double t0 = prof_now();
+
+    memcpy(buf, hist, nbr_bin * sizeof(long long));
+    buf[nbr_bin] = *img_size;
+    if (node_aware)
+    {
+        // Node sum on the leader, leaders only across nodes, back to the node
+        MPI_Reduce((node_rank == 0) ? MPI_IN_PLACE : buf, buf, nbr_bin + 1, MPI_LONG_LONG, MPI_SUM, 0, node_comm);
+        if (leader_comm != MPI_COMM_NULL)
+            MPI_Allreduce(MPI_IN_PLACE, buf, nbr_bin + 1, MPI_LONG_LONG, MPI_SUM, leader_comm);
+        MPI_Bcast(buf, nbr_bin + 1, MPI_LONG_LONG, 0, node_comm);
+    }
+    else
+    {
+        MPI_Allreduce(MPI_IN_PLACE, buf, nbr_bin + 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+    }
+    memcpy(hist, buf, nbr_bin * sizeof(long long));
+    *img_size = buf[nbr_bin];
+    prof_add(STAGE_ALLREDUCE, t0, 0, (long long)(nbr_bin + 1) * sizeof(long long));
+
+    arena_free(buf);
+}
+
+static void mpi_barrier(void)
+{
+    double t0 = prof_now();
+
+    MPI_Barrier(MPI_COMM_WORLD);
+    prof_add(STAGE_BARRIER, t0, 0, 0);
+}
+
+const BACKEND mpi_backend =
+{
+    "mpi", 0, mpi_init, mpi_finalize,
+    mpi_read_pgm, mpi_write_pgm, mpi_free_pgm, mpi_read_ppm, mpi_write_ppm, mpi_free_ppm,
+    mpi_reduce_histogram, mpi_barrier
+};
+
+const BACKEND hybrid_backend =
+{
+    "hybrid", 0, hybrid_init, mpi_finalize,
+    mpi_read_pgm, mpi_write_pgm, mpi_free_pgm, mpi_read_ppm, mpi_write_ppm, mpi_free_ppm,
+    mpi_reduce_histogram, mpi_barrier
+};
+
+#endif
@@ -0,0 +1,170 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "hist-equ.h"
+#include <omp.h>
+
+// Contrast enhancement on packed (interleaved) RGB. Pixels are split into
+// planes one L1-sized block at a time, so the planar SIMD kernels can be
+// reused without a full-image deinterleave pass or temporary planes. The
+// streaming mode runs its strips through the same two functions.
+
+// Pixels handled per block; small enough to stay in L1
+#define PACKED_BLOCK 4096
+
+// Split an interleaved block into planes and back
+static void deinterleave_block(unsigned char * r, unsigned char * g, unsigned char * b,
+                               const unsigned char * rgb, int n)
+{
+    double t0 = prof_now();
+    int k;
+
+    for (k = 0; k < n; k++)
+    {
+        r[k] = rgb[3*k + 0];
+        g[k] = rgb[3*k + 1];
+        b[k] = rgb[3*k + 2];
+    }
+    prof_add(STAGE_DEINTERLEAVE, t0, n, 6LL * n);
+}
+
+static void interleave_block(unsigned char * rgb, const unsigned char * r,
+                             const unsigned char * g, const unsigned char * b, int n)
+{
+    double t0 = prof_now();
+    int k;
+
+    for (k = 0; k < n; k++)
+    {
+        rgb[3*k + 0] = r[k];
+        rgb[3*k + 1] = g[k];
+        rgb[3*k + 2] = b[k];
+    }
+    prof_add(STAGE_INTERLEAVE, t0, n, 6LL * n);
+}
+
+// Add the histogram of Y, L or each of R, G, B over n pixels to total
+void packed_histogram(long long total[3][256], const unsigned char * rgb, long n, STREAM_MODE mode)
+{
+    #pragma omp parallel
+    {
+        unsigned int hist_priv[3][256];
+        unsigned char r[PACKED_BLOCK], g[PACKED_BLOCK], b[PACKED_BLOCK], x[PACKED_BLOCK];
+        double t0;
+        long start, end, j;
+        int m, k, i;
+
+        memset(hist_priv, 0, sizeof(hist_priv));
+
+        // The same slice as packed_equalize, so each thread equalizes the
+        // pixels it read here
+        thread_range(n, omp_get_thread_num(), omp_get_num_threads(), &start, &end);
+        for (j = start; j < end; j += PACKED_BLOCK)
+        {
+            m = (end - j < PACKED_BLOCK) ? (int)(end - j) : PACKED_BLOCK;
+            deinterleave_block(r, g, b, rgb + 3 * j, m);
+
+            if (mode == STREAM_YUV)
+                luma_block(x, r, g, b, m);
+            else if (mode == STREAM_HSL)
+                lightness_block(x, r, g, b, m);
+
+            t0 = prof_now();
+            if (mode == STREAM_RGB)
+            {
+                histogram_kernel(hist_priv[0], r, m);
+                histogram_kernel(hist_priv[1], g, m);
+                histogram_kernel(hist_priv[2], b, m);
+            }
+            else
+            {
+                histogram_kernel(hist_priv[0], x, m);
+            }
+            prof_add(STAGE_HISTOGRAM, t0, m, (mode == STREAM_RGB) ? 3 * m : m);
+        }
+
+        #pragma omp critical
+        {
+            for (k = 0; k < 3; k++)
+            {
+                for (i = 0; i < 256; i++)
+                {
+                    total[k][i] += hist_priv[k][i];
+                }
+            }
+        }
+    }
+}
+
+// Byte LUTs from histograms accumulated over img_size pixels; one LUT for
+// YUV and HSL, one per channel for RGB
+void packed_lut(unsigned char lut[3][256], long long total[3][256], long long img_size, STREAM_MODE mode)
+{
+    int c;
+
+    for (c = 0; c < (mode == STREAM_RGB ? 3 : 1); c++)
+    {
+        histogram_lut_u8_ll(lut[c], total[c], img_size, 256);
+    }
+}
+
+// Equalize n pixels; rgb_out may be rgb_in
+void packed_equalize(unsigned char * rgb_out, const unsigned char * rgb_in,
+                     unsigned char lut[3][256], long n, STREAM_MODE mode)
+{
+    #pragma omp parallel
+    {
+        unsigned char r[PACKED_BLOCK], g[PACKED_BLOCK], b[PACKED_BLOCK];
+        long start, end, j, k;
+        int m;
+
+        thread_range(n, omp_get_thread_num(), omp_get_num_threads(), &start, &end);
+        if (mode == STREAM_RGB)
+        {
+            double t0 = prof_now();
+
+            // Per-channel lookups work on the interleaved bytes directly
+            for (k = start; k < end; k++)
+            {
+                rgb_out[3*k + 0] = lut[0][rgb_in[3*k + 0]];
+                rgb_out[3*k + 1] = lut[1][rgb_in[3*k + 1]];
+                rgb_out[3*k + 2] = lut[2][rgb_in[3*k + 2]];
+            }
+            prof_add(STAGE_APPLY, t0, end - start, 6 * (end - start));
+        }
+        else
+        {
+            for (j = start; j < end; j += PACKED_BLOCK)
+            {
+                m = (end - j < PACKED_BLOCK) ? (int)(end - j) : PACKED_BLOCK;
+                deinterleave_block(r, g, b, rgb_in + 3 * j, m);
+
+                if (mode == STREAM_YUV)
+                    yuv_equalize_block(r, g, b, r, g, b, lut[0], m);
+                else
+                    hsl_equalize_block(r, g, b, r, g, b, lut[0], m);
+
+                interleave_block(rgb_out + 3 * j, r, g, b, m);
+            }
+        }
+    }
+}
+
+RGB_IMG contrast_enhancement_packed(RGB_IMG img_in, STREAM_MODE mode)
+{
+    RGB_IMG result;
+    long long total[3][256];
+    unsigned char lut[3][256];
+    long img_size = (long)img_in.w * img_in.h;
+
+    memset(total, 0, sizeof(total));
+    packed_histogram(total, img_in.img, img_size, mode);
+    packed_lut(lut, total, img_size, mode);
+
+    result.w = img_in.w;
+    result.h = img_in.h;
+    result.img = (unsigned char *)arena_alloc(3 * img_size * sizeof(unsigned char));
+    packed_equalize(result.img, img_in.img, lut, img_size, mode);
+
+    return result;
+}
@@ -0,0 +1,89 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "hist-equ.h"
+
+// Hardware counters of the calling thread through perf_event_open: cycles,
+// instructions, last-level cache misses and branch mispredictions. They are
+// opened as one group, so a read always covers the same interval for all
+// four. Only user space is counted, which perf_event_paranoid <= 2 allows
+// for a process's own threads.
+
+static const unsigned long long perf_configs[PERF_COUNTERS] =
+{
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES,
+    PERF_COUNT_HW_BRANCH_MISSES
+};
+
+static __thread int perf_fds[PERF_COUNTERS];
+static __thread int perf_state = 0;     // 0 not opened, 1 open, -1 failed
+static int perf_errno = 0;
+
+// Open the group for the calling thread; returns 1 on success
+int perf_counters_open(void)
+{
+    struct perf_event_attr attr;
+    int k, j;
+
+    if (perf_state != 0)
+        return perf_state > 0;
+
+    perf_state = -1;
+    for (k = 0; k < PERF_COUNTERS; k++)
+    {
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = perf_configs[k];
+        attr.disabled = (k == 0);
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP;
+
+        perf_fds[k] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, (k == 0) ? -1 : perf_fds[0], 0);
+        if (perf_fds[k] < 0)
+        {
+            perf_errno = errno;
+            for (j = 0; j < k; j++)
+            {
+                close(perf_fds[j]);
+            }
+            return 0;
+        }
+    }
+
+    ioctl(perf_fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    perf_state = 1;
+    return 1;
+}
+
+// Current counts of the calling thread; returns 0 if they are unavailable
+int perf_counters_read(long long values[PERF_COUNTERS])
+{
+    unsigned long long buf[1 + PERF_COUNTERS];
+    int k;
+
+    if (!perf_counters_open())
+        return 0;
+    if (read(perf_fds[0], buf, sizeof(buf)) != (ssize_t)sizeof(buf))
+        return 0;
+
+    for (k = 0; k < PERF_COUNTERS; k++)
+    {
+        values[k] = (long long)buf[1 + k];
+    }
+    return 1;
+}
+
+// Why the counters could not be opened, or NULL
+const char * perf_counters_error(void)
+{
+    return perf_errno ? strerror(perf_errno) : NULL;
+}
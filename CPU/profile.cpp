@@ -0,0 +1,542 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "hist-equ.h"
+#include <omp.h>
+#ifdef HIST_MPI
+#include <mpi.h>
+#endif
+
+// Per-stage instrumentation. Set HIST_PROFILE=<file> to record the time,
+// bytes and calls of every stage per OpenMP thread; the JSON report is
+// written to <file> at exit. Set HIST_TRACE=<file> to also keep every stage
+// and parallel region as a begin/end event per thread, written at exit as a
+// Chrome/Perfetto trace. With both unset prof_now returns 0 and prof_add
+// returns at once.
+//
+// Under the MPI executor the threads of each rank are summed, rank 0 writes
+// the report with one entry per rank, and the trace has one process per
+// rank. Both are collective, so backend_finalize writes them before
+// MPI_Finalize rather than at exit.
+//
+// With HIST_PROFILE set, HIST_COUNTERS=1 also reads the hardware counters
+// of perf-counters.cpp in prof_now and prof_add and reports them per stage,
+// with IPC and misses per pixel. Each read is a system call, so stages
+// timed per block run noticeably slower with counters on.
+//
+// Each OS thread accumulates into its own cache-line aligned slot.
+
+#define PROF_MAX_THREADS 256
+
+// Events kept per thread; later ones are counted as dropped
+#define TRACE_MAX_EVENTS (1 << 20)
+
+static const char * stage_names[STAGE_COUNT] =
+{
+    "read", "deinterleave", "convert", "histogram", "lut",
+    "apply", "reconvert", "interleave", "write", "scatter",
+    "allreduce", "gather", "barrier"
+};
+
+// Trace categories: stage, parallel region, MPI collective or barrier
+static const char * event_kinds[3] = { "stage", "region", "mpi" };
+
+typedef struct
+{
+    const char * name;
+    int kind;              // index into event_kinds
+    double t0;
+    double t1;
+} TRACE_EVENT;
+
+typedef struct
+{
+    double time[STAGE_COUNT];
+    long long pixels[STAGE_COUNT];
+    long long bytes[STAGE_COUNT];
+    long long calls[STAGE_COUNT];
+    long long counters[STAGE_COUNT][PERF_COUNTERS];
+    TRACE_EVENT * events;
+    int nevents;
+    int cap;
+    long long dropped;
+} __attribute__((aligned(64))) PROF_SLOT;
+
+static PROF_SLOT prof_slots[PROF_MAX_THREADS];
+static int prof_nslots = 0;        // slots claimed so far
+static const char * prof_path = NULL;
+static const char * trace_path = NULL;
+static int prof_state = 0;         // 1 with HIST_PROFILE or HIST_TRACE
+static int prof_done = 0;          // reports written
+static int counters_on = 0;
+static double prof_start;
+
+// Counts read by the last prof_now of this thread, and the time it returned
+static __thread long long snap_counters[PERF_COUNTERS];
+static __thread double snap_time = -1;
+static __thread int own_index = -1;
+
+static void prof_exit(void);
+
+// Before main, so the threads that call prof_now only ever read the settings
+__attribute__((constructor))
+static void prof_init(void)
+{
+    prof_path = getenv("HIST_PROFILE");
+    trace_path = getenv("HIST_TRACE");
+    if (prof_path != NULL && prof_path[0] == '\0')
+        prof_path = NULL;
+    if (trace_path != NULL && trace_path[0] == '\0')
+        trace_path = NULL;
+
+    counters_on = (prof_path != NULL && getenv("HIST_COUNTERS") != NULL &&
+                   strcmp(getenv("HIST_COUNTERS"), "0") != 0);
+
+    if (prof_path != NULL || trace_path != NULL)
+    {
+        prof_start = omp_get_wtime();
+        atexit(prof_exit);
+        prof_state = 1;
+    }
+}
+
+static int prof_enabled(void)
+{
+    return prof_state;
+}
+
+double prof_now(void)
+{
+    double t;
+    int ok;
+
+    if (!prof_enabled())
+        return 0;
+    if (!counters_on)
+        return omp_get_wtime();
+
+    ok = perf_counters_read(snap_counters);
+    t = omp_get_wtime();
+    snap_time = ok ? t : -1;
+    return t;
+}
+
+// Slot of the calling OS thread, claimed on first use, so threads of teams
+// that run at the same time (batch stages) never share one. NULL once all
+// slots are taken: those threads are not recorded.
+static PROF_SLOT * own_slot(void)
+{
+    if (own_index < 0)
+        own_index = __atomic_fetch_add(&prof_nslots, 1, __ATOMIC_RELAXED);
+
+    return (own_index < PROF_MAX_THREADS) ? &prof_slots[own_index] : NULL;
+}
+
+static void trace_event(PROF_SLOT * slot, const char * name, int kind, double t0, double t1)
+{
+    TRACE_EVENT * e;
+
+    if (slot->nevents == slot->cap)
+    {
+        int cap = (slot->cap == 0) ? 1024 : 2 * slot->cap;
+        TRACE_EVENT * events;
+
+        if (cap > TRACE_MAX_EVENTS ||
+            (events = (TRACE_EVENT *)realloc(slot->events, cap * sizeof(TRACE_EVENT))) == NULL)
+        {
+            slot->dropped++;
+            return;
+        }
+        slot->events = events;
+        slot->cap = cap;
+    }
+
+    e = &slot->events[slot->nevents++];
+    e->name = name;
+    e->kind = kind;
+    e->t0 = t0;
+    e->t1 = t1;
+}
+
+// Charge the time since t0, pixels and bytes touched to stage on the
+// calling thread. Counters are charged only when t0 came from this thread's
+// last prof_now.
+void prof_add(STAGE stage, double t0, long long pixels, long long bytes)
+{
+    PROF_SLOT * slot;
+    long long now[PERF_COUNTERS];
+    double t1;
+    int k;
+
+    if (!prof_enabled())
+        return;
+
+    slot = own_slot();
+    if (slot == NULL)
+        return;
+    t1 = omp_get_wtime();
+    slot->time[stage] += t1 - t0;
+    slot->pixels[stage] += pixels;
+    slot->bytes[stage] += bytes;
+    slot->calls[stage]++;
+
+    if (counters_on && t0 == snap_time && perf_counters_read(now))
+    {
+        for (k = 0; k < PERF_COUNTERS; k++)
+        {
+            slot->counters[stage][k] += now[k] - snap_counters[k];
+        }
+    }
+
+    if (trace_path != NULL)
+        trace_event(slot, stage_names[stage], (stage >= STAGE_SCATTER) ? 2 : 0, t0, t1);
+}
+
+// Record the calling thread's part of a parallel region, from t0 to now.
+// name must be a string literal.
+void trace_region(const char * name, double t0)
+{
+    PROF_SLOT * slot;
+
+    if (!prof_enabled() || trace_path == NULL)
+        return;
+
+    slot = own_slot();
+    if (slot != NULL)
+        trace_event(slot, name, 1, t0, omp_get_wtime());
+}
+
+// Slots claimed so far
+static int used_slots(void)
+{
+    int n = __atomic_load_n(&prof_nslots, __ATOMIC_RELAXED);
+
+    return (n < PROF_MAX_THREADS) ? n : PROF_MAX_THREADS;
+}
+
+// Stage totals of one thread, or of all threads of one rank
+typedef struct
+{
+    double time[STAGE_COUNT];          // busiest thread
+    double total[STAGE_COUNT];         // sum over threads
+    long long active[STAGE_COUNT];     // threads that ran the stage
+    long long pixels[STAGE_COUNT];
+    long long bytes[STAGE_COUNT];
+    long long calls[STAGE_COUNT];
+    long long counters[STAGE_COUNT][PERF_COUNTERS];
+} PROF_TOTALS;
+
+static void sum_slots(PROF_TOTALS * tot, int first, int last)
+{
+    int s, t, k;
+
+    memset(tot, 0, sizeof(*tot));
+    for (t = first; t < last; t++)
+    {
+        const PROF_SLOT * slot = &prof_slots[t];
+
+        for (s = 0; s < STAGE_COUNT; s++)
+        {
+            if (slot->time[s] > tot->time[s])
+                tot->time[s] = slot->time[s];
+            tot->total[s] += slot->time[s];
+            tot->active[s] += (slot->calls[s] > 0);
+            tot->pixels[s] += slot->pixels[s];
+            tot->bytes[s] += slot->bytes[s];
+            tot->calls[s] += slot->calls[s];
+            for (k = 0; k < PERF_COUNTERS; k++)
+            {
+                tot->counters[s][k] += slot->counters[s][k];
+            }
+        }
+    }
+}
+
+// Counter totals of one stage, with IPC and misses per pixel
+static void print_counters(FILE * out, const long long counters[PERF_COUNTERS], long long pixels)
+{
+    fprintf(out, "     \"cycles\": %lld, \"instructions\": %lld, \"llc_misses\": %lld, "
+            "\"branch_misses\": %lld,\n", counters[0], counters[1], counters[2], counters[3]);
+    fprintf(out, "     \"ipc\": %.3f, \"llc_misses_per_pixel\": %.5f, \"branch_misses_per_pixel\": %.5f,\n",
+            (counters[0] > 0) ? (double)counters[1] / counters[0] : 0.0,
+            (pixels > 0) ? (double)counters[2] / pixels : 0.0,
+            (pixels > 0) ? (double)counters[3] / pixels : 0.0);
+}
+
+// For each stage: time_ms is the busiest thread (the stage's critical path),
+// total_ms the sum over threads and imbalance the busiest thread over the
+// mean of the threads that ran the stage. The n entries of tot are threads
+// or ranks, as unit says, and their times are listed per stage.
+static void write_report(const PROF_TOTALS * tot, int n, const char * unit, double wall)
+{
+    const BACKEND * backend = backend_current();
+    int nstages = backend->local ? STAGE_SCATTER : STAGE_COUNT;
+    FILE * out;
+    int s, i, k;
+
+    out = fopen(prof_path, "w");
+    if (out == NULL)
+    {
+        printf("Cannot write profile %s!\n", prof_path);
+        return;
+    }
+
+    fprintf(out, "{\n");
+    fprintf(out, "  \"backend\": \"%s\",\n", backend->name);
+    fprintf(out, "  \"%s\": %d,\n", unit, n);
+    fprintf(out, "  \"kernels\": {\"histogram\": \"%s\", \"lut\": \"%s\", \"color\": \"%s\"},\n",
+            histogram_kernel_name(), lut_apply_kernel_name(), color_kernel_name());
+    fprintf(out, "  \"wall_ms\": %.3f,\n", wall * 1e3);
+    if (!counters_on)
+        fprintf(out, "  \"counters\": \"off\",\n");
+    else if (perf_counters_error() != NULL)
+        fprintf(out, "  \"counters\": \"unavailable: %s\",\n", perf_counters_error());
+    else
+        fprintf(out, "  \"counters\": \"perf_event\",\n");
+    fprintf(out, "  \"stages\": [\n");
+
+    for (s = 0; s < nstages; s++)
+    {
+        double max = 0, sum = 0;
+        long long pixels = 0, bytes = 0, calls = 0, active = 0;
+        long long counters[PERF_COUNTERS] = {0};
+
+        for (i = 0; i < n; i++)
+        {
+            if (tot[i].time[s] > max)
+                max = tot[i].time[s];
+            sum += tot[i].total[s];
+            active += tot[i].active[s];
+            pixels += tot[i].pixels[s];
+            bytes += tot[i].bytes[s];
+            calls += tot[i].calls[s];
+            for (k = 0; k < PERF_COUNTERS; k++)
+            {
+                counters[k] += tot[i].counters[s][k];
+            }
+        }
+
+        fprintf(out, "    {\"name\": \"%s\", \"time_ms\": %.3f, \"total_ms\": %.3f, "
+                "\"calls\": %lld, \"pixels\": %lld, \"bytes\": %lld, \"gb_per_s\": %.3f, \"imbalance\": %.3f,\n",
+                stage_names[s], max * 1e3, sum * 1e3, calls, pixels, bytes,
+                (max > 0) ? bytes / max / 1e9 : 0.0,
+                (active > 0 && sum > 0) ? max / (sum / active) : 0.0);
+        if (counters_on)
+            print_counters(out, counters, pixels);
+        fprintf(out, "     \"%s_ms\": [", unit);
+        for (i = 0; i < n; i++)
+        {
+            fprintf(out, "%s%.3f", (i > 0) ? ", " : "", tot[i].time[s] * 1e3);
+        }
+        fprintf(out, "]}%s\n", (s + 1 < nstages) ? "," : "");
+    }
+
+    fprintf(out, "  ]\n}\n");
+    fclose(out);
+}
+
+// Chrome trace event format: one complete ("X") event per stage, region or
+// collective, with this process as pid and its threads as tids, timestamps
+// in microseconds since origin. Every entry but the very first of the file
+// (that of pid 0) starts with a comma. Returns the events dropped.
+static long long write_events(FILE * out, int pid, const char * process, double origin)
+{
+    int nthreads = used_slots();
+    long long dropped = 0;
+    int t, i;
+
+    fprintf(out, "%s  {\"name\": \"process_name\", \"ph\": \"M\", \"pid\": %d, \"tid\": 0, "
+            "\"args\": {\"name\": \"%s\"}}", (pid > 0) ? ",\n" : "", pid, process);
+
+    for (t = 0; t < nthreads; t++)
+    {
+        fprintf(out, ",\n  {\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": %d, \"tid\": %d, "
+                "\"args\": {\"name\": \"thread %d\"}}", pid, t, t);
+
+        for (i = 0; i < prof_slots[t].nevents; i++)
+        {
+            const TRACE_EVENT * e = &prof_slots[t].events[i];
+
+            fprintf(out, ",\n  {\"name\": \"%s\", \"cat\": \"%s\", \"ph\": \"X\", \"pid\": %d, "
+                    "\"tid\": %d, \"ts\": %.3f, \"dur\": %.3f}",
+                    e->name, event_kinds[e->kind], pid, t,
+                    (e->t0 - origin) * 1e6, (e->t1 - e->t0) * 1e6);
+        }
+        dropped += prof_slots[t].dropped;
+        free(prof_slots[t].events);
+        prof_slots[t].events = NULL;
+        prof_slots[t].nevents = prof_slots[t].cap = 0;
+    }
+
+    return dropped;
+}
+
+static void stage_report(void)
+{
+    int nthreads = used_slots();
+    PROF_TOTALS * tot = (PROF_TOTALS *)malloc(sizeof(PROF_TOTALS) * nthreads);
+    int t;
+
+    for (t = 0; t < nthreads; t++)
+    {
+        sum_slots(&tot[t], t, t + 1);
+    }
+    write_report(tot, nthreads, "threads", omp_get_wtime() - prof_start);
+    free(tot);
+}
+
+static void trace_report(void)
+{
+    FILE * out;
+    long long dropped;
+
+    out = fopen(trace_path, "w");
+    if (out == NULL)
+    {
+        printf("Cannot write trace %s!\n", trace_path);
+        return;
+    }
+
+    fprintf(out, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+    dropped = write_events(out, 0, backend_current()->name, prof_start);
+    fprintf(out, "\n]}\n");
+    fclose(out);
+
+    if (dropped > 0)
+        printf("Trace %s: %lld events dropped!\n", trace_path, dropped);
+}
+
+#ifdef HIST_MPI
+
+// Totals of every rank gathered on rank 0, which writes the report
+static void mpi_stage_report(int rank, int size)
+{
+    PROF_TOTALS own;
+    PROF_TOTALS * all = NULL;
+    double wall = omp_get_wtime() - prof_start;
+
+    sum_slots(&own, 0, used_slots());
+    if (rank == 0)
+        all = (PROF_TOTALS *)malloc(sizeof(PROF_TOTALS) * size);
+    MPI_Gather(&own, sizeof(own), MPI_BYTE, all, sizeof(own), MPI_BYTE, 0, MPI_COMM_WORLD);
+    MPI_Reduce(rank == 0 ? MPI_IN_PLACE : &wall, &wall, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+
+    if (rank == 0)
+        write_report(all, size, "ranks", wall);
+    free(all);
+}
+
+// Every rank formats its own events; rank 0 gathers and writes the text.
+// Clocks are aligned at a barrier, and timestamps start at the earliest
+// event of any rank.
+static void mpi_trace_report(int rank, int size)
+{
+    double sync, first;
+    long long dropped, total_dropped = 0;
+    char process[32];
+    char * text = NULL;
+    char * all = NULL;
+    size_t len = 0;
+    int * counts = NULL;
+    int * displs = NULL;
+    int nthreads = used_slots();
+    int total = 0, count, t, i, r;
+    FILE * mem;
+    FILE * out;
+
+    MPI_Barrier(MPI_COMM_WORLD);
+    sync = omp_get_wtime();
+    first = 0;
+    for (t = 0; t < nthreads; t++)
+    {
+        for (i = 0; i < prof_slots[t].nevents; i++)
+        {
+            if (prof_slots[t].events[i].t0 - sync < first)
+                first = prof_slots[t].events[i].t0 - sync;
+        }
+    }
+    MPI_Allreduce(MPI_IN_PLACE, &first, 1, MPI_DOUBLE, MPI_MIN, MPI_COMM_WORLD);
+
+    snprintf(process, sizeof(process), "rank %d", rank);
+    mem = open_memstream(&text, &len);
+    dropped = write_events(mem, rank, process, sync + first);
+    fclose(mem);
+
+    count = (int)len;
+    if (rank == 0)
+    {
+        counts = (int *)malloc(sizeof(int) * size);
+        displs = (int *)malloc(sizeof(int) * size);
+    }
+    MPI_Gather(&count, 1, MPI_INT, counts, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    MPI_Reduce(&dropped, &total_dropped, 1, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+    if (rank == 0)
+    {
+        for (r = 0; r < size; r++)
+        {
+            displs[r] = total;
+            total += counts[r];
+        }
+        all = (char *)malloc(total > 0 ? total : 1);
+    }
+    MPI_Gatherv(text, count, MPI_CHAR, all, counts, displs, MPI_CHAR, 0, MPI_COMM_WORLD);
+    free(text);
+
+    if (rank == 0)
+    {
+        out = fopen(trace_path, "w");
+        if (out == NULL)
+        {
+            printf("Cannot write trace %s!\n", trace_path);
+        }
+        else
+        {
+            fprintf(out, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+            fwrite(all, 1, total, out);
+            fprintf(out, "\n]}\n");
+            fclose(out);
+        }
+
+        if (total_dropped > 0)
+            printf("Trace %s: %lld events dropped!\n", trace_path, total_dropped);
+    }
+
+    free(all);
+    free(counts);
+    free(displs);
+}
+
+#endif
+
+// Write the profile and the trace once. Every MPI rank must call it, before
+// MPI_Finalize; single-process executors also get it at exit.
+void prof_report(void)
+{
+    if (!prof_enabled() || prof_done)
+        return;
+    prof_done = 1;
+
+#ifdef HIST_MPI
+    if (!backend_current()->local)
+    {
+        if (prof_path != NULL)
+            mpi_stage_report(backend_rank(), backend_size());
+        if (trace_path != NULL)
+            mpi_trace_report(backend_rank(), backend_size());
+        return;
+    }
+#endif
+
+    if (prof_path != NULL)
+        stage_report();
+    if (trace_path != NULL)
+        trace_report();
+}
+
+// Collectives are not possible at exit, so an MPI run that did not reach
+// backend_finalize writes nothing
+static void prof_exit(void)
+{
+    if (backend_current()->local)
+        prof_report();
+}
@@ -0,0 +1,314 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <limits.h>
+#include "hist-equ.h"
+#include <omp.h>
+
+// Frame-sequence mode. Histograms of the last `window` frames are kept in a
+// ring with a running sum, and each frame is mapped through the LUT of that
+// sum, so the mapping drifts smoothly instead of flickering. With overlap
+// on, frame N+1 is read before frame N is equalized and one fused pass
+// applies the LUT to frame N while it accumulates the histogram of frame
+// N+1. Each frame's LUT still covers its own histogram, so both schedules
+// give identical output.
+
+// Pixels handled per block; small enough to stay in L1
+#define SEQ_BLOCK 4096
+
+typedef struct
+{
+    int is_color;
+    PGM_IMG gray;
+    PPM_IMG color;
+} SEQ_FRAME;
+
+typedef struct
+{
+    int window;
+    int count;             // frames in the ring
+    int next;              // ring slot of the next frame
+    long long (*ring)[3][256];
+    long long sum[3][256];
+} LUT_SMOOTHER;
+
+static void read_frame(SEQ_FRAME * f, const char * path, int is_color)
+{
+    f->is_color = is_color;
+    if (is_color)
+        f->color = read_ppm(path);
+    else
+        f->gray = read_pgm(path);
+}
+
+static void write_frame(SEQ_FRAME * f, const char * path)
+{
+    if (f->is_color)
+        write_ppm(f->color, path);
+    else
+        write_pgm(f->gray, path);
+}
+
+static void free_frame(SEQ_FRAME * f)
+{
+    if (f->is_color)
+        free_ppm(f->color);
+    else
+        free_pgm(f->gray);
+}
+
+static long frame_size(const SEQ_FRAME * f)
+{
+    return f->is_color ? (long)f->color.w * f->color.h : (long)f->gray.w * f->gray.h;
+}
+
+static SEQ_FRAME alloc_frame(const SEQ_FRAME * f)
+{
+    SEQ_FRAME out = *f;
+    long n = frame_size(f);
+
+    if (f->is_color)
+    {
+        out.color.img_r = (unsigned char *)arena_alloc(n);
+        out.color.img_g = (unsigned char *)arena_alloc(n);
+        out.color.img_b = (unsigned char *)arena_alloc(n);
+    }
+    else
+    {
+        out.gray.img = (unsigned char *)arena_alloc(n);
+    }
+
+    return out;
+}
+
+// Histogram of Y, L, R/G/B or gray over pixels [j, j + m)
+static void hist_block(unsigned int hist[3][256], const SEQ_FRAME * f, long j, int m, STREAM_MODE mode)
+{
+    unsigned char x[SEQ_BLOCK];
+    const PPM_IMG * c = &f->color;
+
+    if (!f->is_color)
+    {
+        histogram_kernel(hist[0], f->gray.img + j, m);
+    }
+    else if (mode == STREAM_YUV)
+    {
+        luma_block(x, c->img_r + j, c->img_g + j, c->img_b + j, m);
+        histogram_kernel(hist[0], x, m);
+    }
+    else if (mode == STREAM_HSL)
+    {
+        lightness_block(x, c->img_r + j, c->img_g + j, c->img_b + j, m);
+        histogram_kernel(hist[0], x, m);
+    }
+    else
+    {
+        histogram_kernel(hist[0], c->img_r + j, m);
+        histogram_kernel(hist[1], c->img_g + j, m);
+        histogram_kernel(hist[2], c->img_b + j, m);
+    }
+}
+
+// Equalize pixels [j, j + m) of f into out
+static void apply_block(SEQ_FRAME * out, const SEQ_FRAME * f, unsigned char lut[3][256],
+                        long j, int m, STREAM_MODE mode)
+{
+    const PPM_IMG * c = &f->color;
+    PPM_IMG * o = &out->color;
+
+    if (!f->is_color)
+        lut_apply_kernel(out->gray.img + j, f->gray.img + j, lut[0], m);
+    else if (mode == STREAM_YUV)
+        yuv_equalize_block(o->img_r + j, o->img_g + j, o->img_b + j,
+                           c->img_r + j, c->img_g + j, c->img_b + j, lut[0], m);
+    else if (mode == STREAM_HSL)
+        hsl_equalize_block(o->img_r + j, o->img_g + j, o->img_b + j,
+                           c->img_r + j, c->img_g + j, c->img_b + j, lut[0], m);
+    else
+    {
+        lut_apply_kernel(o->img_r + j, c->img_r + j, lut[0], m);
+        lut_apply_kernel(o->img_g + j, c->img_g + j, lut[1], m);
+        lut_apply_kernel(o->img_b + j, c->img_b + j, lut[2], m);
+    }
+}
+
+// One parallel pass: equalize cur into out (if cur) and add the histogram of
+// next to total (if next)
+static void fused_pass(SEQ_FRAME * out, const SEQ_FRAME * cur, unsigned char lut[3][256],
+                       const SEQ_FRAME * next, long long total[3][256], STREAM_MODE mode)
+{
+    long n_cur = cur ? frame_size(cur) : 0;
+    long n_next = next ? frame_size(next) : 0;
+    long n = (n_cur > n_next) ? n_cur : n_next;
+
+    #pragma omp parallel
+    {
+        unsigned int hist_priv[3][256];
+        long start, end, j, m;
+        int k, i;
+
+        memset(hist_priv, 0, sizeof(hist_priv));
+
+        // The split of read_frame, so each thread works on the pages it read
+        thread_range(n, omp_get_thread_num(), omp_get_num_threads(), &start, &end);
+        for (j = start; j < end; j += SEQ_BLOCK)
+        {
+            m = (end - j < SEQ_BLOCK) ? end - j : SEQ_BLOCK;
+            if (j < n_cur)
+                apply_block(out, cur, lut, j, (int)((n_cur - j < m) ? n_cur - j : m), mode);
+            if (j < n_next)
+                hist_block(hist_priv, next, j, (int)((n_next - j < m) ? n_next - j : m), mode);
+        }
+
+        if (next)
+        {
+            #pragma omp critical
+            {
+                for (k = 0; k < 3; k++)
+                {
+                    for (i = 0; i < 256; i++)
+                    {
+                        total[k][i] += hist_priv[k][i];
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Add a frame histogram to the window, dropping the oldest one when full
+static void smoother_push(LUT_SMOOTHER * sm, long long hist[3][256])
+{
+    int k, i;
+
+    for (k = 0; k < 3; k++)
+    {
+        for (i = 0; i < 256; i++)
+        {
+            if (sm->count == sm->window)
+                sm->sum[k][i] -= sm->ring[sm->next][k][i];
+            sm->ring[sm->next][k][i] = hist[k][i];
+            sm->sum[k][i] += hist[k][i];
+        }
+    }
+
+    if (sm->count < sm->window)
+        sm->count++;
+    sm->next = (sm->next + 1) % sm->window;
+}
+
+// LUTs of the windowed histograms
+static void smoother_lut(LUT_SMOOTHER * sm, unsigned char lut[3][256], int channels)
+{
+    int k, i;
+
+    for (k = 0; k < channels; k++)
+    {
+        long long total = 0;
+
+        for (i = 0; i < 256; i++)
+        {
+            total += sm->sum[k][i];
+        }
+        histogram_lut_u8_ll(lut[k], sm->sum[k], total, 256);
+    }
+}
+
+void sequence_contrast_enhancement(char ** inputs, int ninputs, const SEQUENCE_OPTIONS * opt)
+{
+    LUT_SMOOTHER sm;
+    SEQ_FRAME cur, next, out;
+    long long total[3][256];
+    unsigned char lut[3][256];
+    char out_path[PATH_MAX];
+    char ** files;
+    int nfiles, is_color, channels, k;
+    double start, t_read = 0, t_write = 0, t;
+
+    files = collect_inputs(inputs, ninputs, &nfiles);
+    if (nfiles == 0)
+    {
+        printf("No input frames!\n");
+        return;
+    }
+    prepare_outputs(opt->out_dir, files, nfiles);
+
+    is_color = strlen(files[0]) > 4 && strcmp(files[0] + strlen(files[0]) - 4, ".ppm") == 0;
+    for (k = 1; k < nfiles; k++)
+    {
+        if ((strlen(files[k]) > 4 && strcmp(files[k] + strlen(files[k]) - 4, ".ppm") == 0) != is_color)
+        {
+            printf("%s: a sequence cannot mix gray and color frames!\n", files[k]);
+            exit(1);
+        }
+    }
+    channels = (is_color && opt->mode == STREAM_RGB) ? 3 : 1;
+
+    sm.window = (opt->window < 1) ? 1 : opt->window;
+    sm.count = 0;
+    sm.next = 0;
+    sm.ring = (long long (*)[3][256])calloc(sm.window, sizeof(*sm.ring));
+    memset(sm.sum, 0, sizeof(sm.sum));
+
+    printf("Sequence of %d frames: window %d, %s\n", nfiles, sm.window,
+           opt->overlap ? "apply overlapped with the next histogram" : "serial passes");
+
+    memset(&next, 0, sizeof(next));
+    start = omp_get_wtime();
+
+    t = omp_get_wtime();
+    read_frame(&cur, files[0], is_color);
+    t_read += omp_get_wtime() - t;
+
+    // The histogram of the first frame has nothing to overlap with
+    memset(total, 0, sizeof(total));
+    fused_pass(NULL, NULL, lut, &cur, total, opt->mode);
+
+    for (k = 0; k < nfiles; k++)
+    {
+        smoother_push(&sm, total);
+        smoother_lut(&sm, lut, channels);
+        out = alloc_frame(&cur);
+        memset(total, 0, sizeof(total));
+
+        if (opt->overlap && k + 1 < nfiles)
+        {
+            t = omp_get_wtime();
+            read_frame(&next, files[k + 1], is_color);
+            t_read += omp_get_wtime() - t;
+
+            fused_pass(&out, &cur, lut, &next, total, opt->mode);
+        }
+        else
+        {
+            fused_pass(&out, &cur, lut, NULL, total, opt->mode);
+            if (k + 1 < nfiles)
+            {
+                t = omp_get_wtime();
+                read_frame(&next, files[k + 1], is_color);
+                t_read += omp_get_wtime() - t;
+
+                fused_pass(NULL, NULL, lut, &next, total, opt->mode);
+            }
+        }
+
+        t = omp_get_wtime();
+        snprintf(out_path, sizeof(out_path), "%s/%s", opt->out_dir,
+                 strrchr(files[k], '/') ? strrchr(files[k], '/') + 1 : files[k]);
+        write_frame(&out, out_path);
+        t_write += omp_get_wtime() - t;
+
+        free_frame(&out);
+        free_frame(&cur);
+        cur = next;
+    }
+
+    start = omp_get_wtime() - start;
+    printf("Sequence processing time: %lf (ms), %.2f fps (read %lf ms, write %lf ms)\n",
+           start * 1000.0, nfiles / start, t_read * 1000.0, t_write * 1000.0);
+
+    free(sm.ring);
+    for (k = 0; k < nfiles; k++)
+        free(files[k]);
+    free(files);
+}
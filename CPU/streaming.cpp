@@ -0,0 +1,220 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <fcntl.h>
+#include "hist-equ.h"
+#include <omp.h>
+
+// Out-of-core histogram equalization. The input is read twice in row
+// strips: the first pass only accumulates the global histogram, the second
+// applies the LUT and writes each strip as soon as it is done. Only one
+// strip of at most mem_budget bytes is resident, and each strip is
+// processed in place, so images larger than RAM can be equalized. Color
+// strips go through the packed RGB path.
+
+typedef struct
+{
+    FILE * in_file;
+    long offset;           // first pixel in the input file
+    int w;
+    int h;
+    int channels;          // 1 for PGM, 3 for PPM
+    int rows;              // rows per strip
+    unsigned char * strip;
+} STREAM;
+
+static void stream_open(STREAM * st, const char * path, char magic, int channels, size_t mem_budget)
+{
+    size_t row_bytes;
+    int v_max;
+
+    st->in_file = fopen(path, "rb");
+    if (st->in_file == NULL)
+    {
+        printf("Input file not found!\n");
+        exit(1);
+    }
+    posix_fadvise(fileno(st->in_file), 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    st->offset = read_pnm_header(st->in_file, magic, &st->w, &st->h, &v_max, path);
+    if (v_max > 255)
+    {
+        printf("%s has 16-bit samples, streaming mode is 8-bit only!\n", path);
+        exit(1);
+    }
+    st->channels = channels;
+
+    row_bytes = (size_t)st->w * channels;
+    // Strips are counted in int pixels, whatever the budget
+    st->rows = (int)((mem_budget / row_bytes < (size_t)(INT_MAX / st->w)) ?
+                     mem_budget / row_bytes : (size_t)(INT_MAX / st->w));
+    if (st->rows < 1)
+        st->rows = 1;
+    if (st->rows > st->h)
+        st->rows = st->h;
+
+    st->strip = (unsigned char *)malloc(row_bytes * st->rows);
+    if (st->strip == NULL)
+    {
+        printf("Cannot allocate a %d-row strip!\n", st->rows);
+        exit(1);
+    }
+
+    printf("Streaming %s: %d x %d in strips of %d rows (%zu bytes)\n",
+           path, st->w, st->h, st->rows, row_bytes * st->rows);
+}
+
+static void stream_rewind(STREAM * st)
+{
+    fseeko(st->in_file, (off_t)st->offset, SEEK_SET);
+}
+
+// Read the strip starting at row y; returns its number of pixels
+static int stream_read(STREAM * st, int y, const char * path)
+{
+    int rows = (st->h - y < st->rows) ? st->h - y : st->rows;
+    size_t bytes = (size_t)rows * st->w * st->channels;
+    double t0 = prof_now();
+
+    if (fread(st->strip, 1, bytes, st->in_file) != bytes)
+    {
+        printf("%s is truncated!\n", path);
+        exit(1);
+    }
+    prof_add(STAGE_READ, t0, (long long)rows * st->w, (long long)bytes);
+
+    return rows * st->w;
+}
+
+static void stream_close(STREAM * st)
+{
+    fclose(st->in_file);
+    free(st->strip);
+}
+
+static FILE * open_output(const char * path, const char * magic, int w, int h)
+{
+    FILE * out_file = fopen(path, "wb");
+
+    if (out_file == NULL)
+    {
+        printf("Cannot create %s!\n", path);
+        exit(1);
+    }
+    fprintf(out_file, "%s\n", magic);
+    fprintf(out_file, "%d %d\n255\n", w, h);
+
+    return out_file;
+}
+
+// Write n pixels of channels bytes each
+static void write_strip(FILE * out_file, const unsigned char * strip, long n, int channels, const char * path)
+{
+    size_t bytes = (size_t)n * channels;
+    double t0 = prof_now();
+
+    if (fwrite(strip, 1, bytes, out_file) != bytes)
+    {
+        printf("Cannot write %s!\n", path);
+        exit(1);
+    }
+    prof_add(STAGE_WRITE, t0, n, (long long)bytes);
+}
+
+void stream_contrast_enhancement_g(const char * in_path, const char * out_path, size_t mem_budget)
+{
+    STREAM st;
+    FILE * out_file;
+    long long total[256] = {0};
+    unsigned char lut[256];
+    int y, n;
+
+    stream_open(&st, in_path, '5', 1, mem_budget);
+
+    /* Pass 1: global histogram */
+    for (y = 0; y < st.h; y += st.rows)
+    {
+        n = stream_read(&st, y, in_path);
+
+        #pragma omp parallel
+        {
+            unsigned int hist_priv[256] = {0};
+            int id = omp_get_thread_num();
+            int nth = omp_get_num_threads();
+            long start = (long)n * id / nth;
+            long end = (long)n * (id + 1) / nth;
+            int j;
+
+            histogram_kernel(hist_priv, st.strip + start, (int)(end - start));
+
+            #pragma omp critical
+            {
+                for (j = 0; j < 256; j++)
+                {
+                    total[j] += hist_priv[j];
+                }
+            }
+        }
+    }
+
+    histogram_lut_u8_ll(lut, total, (long long)st.w * st.h, 256);
+
+    /* Pass 2: apply the LUT strip by strip */
+    out_file = open_output(out_path, "P5", st.w, st.h);
+    stream_rewind(&st);
+    for (y = 0; y < st.h; y += st.rows)
+    {
+        n = stream_read(&st, y, in_path);
+
+        #pragma omp parallel
+        {
+            int id = omp_get_thread_num();
+            int nth = omp_get_num_threads();
+            long start = (long)n * id / nth;
+            long end = (long)n * (id + 1) / nth;
+
+            lut_apply_kernel(st.strip + start, st.strip + start, lut, (int)(end - start));
+        }
+
+        write_strip(out_file, st.strip, n, 1, out_path);
+    }
+
+    fclose(out_file);
+    stream_close(&st);
+}
+
+void stream_contrast_enhancement_c(const char * in_path, const char * out_path,
+                                   STREAM_MODE mode, size_t mem_budget)
+{
+    STREAM st;
+    FILE * out_file;
+    long long total[3][256];
+    unsigned char lut[3][256];
+    int y, n;
+
+    memset(total, 0, sizeof(total));
+    stream_open(&st, in_path, '6', 3, mem_budget);
+
+    /* Pass 1: global histogram of Y, L or each of R, G, B */
+    for (y = 0; y < st.h; y += st.rows)
+    {
+        n = stream_read(&st, y, in_path);
+        packed_histogram(total, st.strip, n, mode);
+    }
+
+    packed_lut(lut, total, (long long)st.w * st.h, mode);
+
+    /* Pass 2: equalize each strip in place and write it */
+    out_file = open_output(out_path, "P6", st.w, st.h);
+    stream_rewind(&st);
+    for (y = 0; y < st.h; y += st.rows)
+    {
+        n = stream_read(&st, y, in_path);
+        packed_equalize(st.strip, st.strip, lut, n, mode);
+        write_strip(out_file, st.strip, n, 3, out_path);
+    }
+
+    fclose(out_file);
+    stream_close(&st);
+}
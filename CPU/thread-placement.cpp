@@ -0,0 +1,262 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <sched.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include "hist-equ.h"
+#include <omp.h>
+
+// NUMA placement of the OpenMP threads. HIST_PIN=compact pins thread t to
+// the t-th CPU the process may run on, so threads fill a socket before the
+// next one; HIST_PIN=spread takes one CPU of every NUMA node in turn, so a
+// few threads already use the memory bandwidth of all sockets. Under MPI
+// thread t of rank r takes the slot r * threads + t, which also works when
+// mpirun binds each rank to its own cores. HIST_PIN=report leaves the
+// threads where they are. In all three cases every thread of the default
+// team prints its CPU and node once, at startup.
+//
+// Nodes come from /sys/devices/system/node and page locations from the
+// move_pages system call, so nothing beyond the C library is needed. Pinning
+// only pays off together with first touch: thread_range gives a thread the
+// same pages of a plane in every pass, and read_ppm/read_pgm write them
+// first from that thread, so the pages are allocated on its node.
+
+#define PLACEMENT_MAX_CPUS 1024
+
+enum { PIN_OFF, PIN_REPORT, PIN_COMPACT, PIN_SPREAD };
+
+static int pin_mode = PIN_OFF;
+static int nnodes = 1;
+static int cpu_node[PLACEMENT_MAX_CPUS];
+static int thread_cpu[PLACEMENT_MAX_CPUS];
+static cpu_set_t process_cpus;        // affinity before pinning
+static const char * pin_names[] = { "off", "report", "compact", "spread" };
+
+// Node of every CPU from the cpulist ("0-3,8-11") of each node directory;
+// without /sys/devices/system/node every CPU is on node 0
+static void read_nodes(void)
+{
+    DIR * dir = opendir("/sys/devices/system/node");
+    struct dirent * entry;
+    char path[300];
+    FILE * in;
+    int node, a, b, c;
+
+    memset(cpu_node, 0, sizeof(cpu_node));
+    if (dir == NULL)
+        return;
+
+    while ((entry = readdir(dir)) != NULL)
+    {
+        if (sscanf(entry->d_name, "node%d", &node) != 1)
+            continue;
+        snprintf(path, sizeof(path), "/sys/devices/system/node/%s/cpulist", entry->d_name);
+        in = fopen(path, "r");
+        if (in == NULL)
+            continue;
+
+        while (fscanf(in, "%d", &a) == 1)
+        {
+            b = a;
+            if (fscanf(in, "-%d", &b) != 1)
+                b = a;
+            for (c = a; c <= b && c < PLACEMENT_MAX_CPUS; c++)
+            {
+                cpu_node[c] = node;
+            }
+            if (fgetc(in) != ',')
+                break;
+        }
+        fclose(in);
+        if (node + 1 > nnodes)
+            nnodes = node + 1;
+    }
+    closedir(dir);
+}
+
+// CPUs of the process in pinning order; returns how many
+static int pin_order(int * order)
+{
+    int taken[PLACEMENT_MAX_CPUS] = {0};
+    int ncpus = 0, n = 0, node, c;
+
+    for (c = 0; c < PLACEMENT_MAX_CPUS; c++)
+    {
+        if (CPU_ISSET(c, &process_cpus))
+            order[ncpus++] = c;
+    }
+    if (pin_mode != PIN_SPREAD)
+        return ncpus;
+
+    // Round robin over the nodes, lowest free CPU of each node first
+    while (n < ncpus)
+    {
+        for (node = 0; node < nnodes; node++)
+        {
+            for (c = 0; c < PLACEMENT_MAX_CPUS; c++)
+            {
+                if (CPU_ISSET(c, &process_cpus) && !taken[c] && cpu_node[c] == node)
+                {
+                    taken[c] = 1;
+                    order[n++] = c;
+                    break;
+                }
+            }
+        }
+    }
+    return ncpus;
+}
+
+static void print_placement(int nthreads)
+{
+    int node, t, count;
+
+    if (backend_size() > 1)
+        printf("Rank %d: ", backend_rank());
+    printf("Thread placement (HIST_PIN=%s), %d threads on %d NUMA node(s):\n",
+           pin_names[pin_mode], nthreads, nnodes);
+    for (node = 0; node < nnodes; node++)
+    {
+        count = 0;
+        for (t = 0; t < nthreads; t++)
+        {
+            if (cpu_node[thread_cpu[t]] != node)
+                continue;
+            if (count++ == 0)
+                printf("  node %d:", node);
+            printf(" %d@cpu%d", t, thread_cpu[t]);
+        }
+        if (count > 0)
+            printf("\n");
+    }
+}
+
+// Called once by backend_init, after the executor has set the thread count
+void placement_init(void)
+{
+    const char * env = getenv("HIST_PIN");
+    int order[PLACEMENT_MAX_CPUS];
+    int ncpus, nthreads = 1;
+
+    if (env == NULL || env[0] == '\0' || strcmp(env, "off") == 0)
+        return;
+    if (strcmp(env, "report") == 0)
+        pin_mode = PIN_REPORT;
+    else if (strcmp(env, "compact") == 0)
+        pin_mode = PIN_COMPACT;
+    else if (strcmp(env, "spread") == 0)
+        pin_mode = PIN_SPREAD;
+    else
+    {
+        printf("Unknown HIST_PIN=%s, use compact, spread or report!\n", env);
+        exit(1);
+    }
+
+    read_nodes();
+    if (sched_getaffinity(0, sizeof(process_cpus), &process_cpus) != 0)
+    {
+        printf("Cannot read the CPU affinity of the process!\n");
+        exit(1);
+    }
+    ncpus = pin_order(order);
+
+    #pragma omp parallel
+    {
+        int t = omp_get_thread_num();
+        int nth = omp_get_num_threads();
+
+        if (pin_mode != PIN_REPORT && ncpus > 0)
+        {
+            cpu_set_t set;
+            int cpu = order[((long)backend_rank() * nth + t) % ncpus];
+
+            CPU_ZERO(&set);
+            CPU_SET(cpu, &set);
+            if (sched_setaffinity(0, sizeof(set), &set) != 0)
+                printf("Cannot pin thread %d to CPU %d!\n", t, cpu);
+        }
+        if (t < PLACEMENT_MAX_CPUS)
+            thread_cpu[t] = sched_getcpu();
+
+        #pragma omp single
+        nthreads = (nth < PLACEMENT_MAX_CPUS) ? nth : PLACEMENT_MAX_CPUS;
+    }
+
+    print_placement(nthreads);
+}
+
+int placement_enabled(void)
+{
+    return pin_mode != PIN_OFF;
+}
+
+// Give the calling thread back every CPU of the process. For threads that
+// are not part of the default team, like the batch pipeline stages, which
+// would otherwise inherit the single CPU of the thread that created them.
+void placement_unpin(void)
+{
+    if (pin_mode == PIN_COMPACT || pin_mode == PIN_SPREAD)
+        sched_setaffinity(0, sizeof(process_cpus), &process_cpus);
+}
+
+// Share of the pages of a plane that are on the node of the thread that
+// processes them under thread_range. Only the pages of the first team of
+// the process are checked, and only when HIST_PIN is set.
+void placement_check(const char * name, const unsigned char * plane, long n)
+{
+    long page = sysconf(_SC_PAGESIZE);
+    long npages = 0, local = 0, missing = 0;
+    int nth = omp_get_max_threads();
+    int t;
+
+    if (pin_mode == PIN_OFF || plane == NULL || n <= 0)
+        return;
+
+    for (t = 0; t < nth && t < PLACEMENT_MAX_CPUS; t++)
+    {
+        long start, end, first, last, i, count;
+        void ** pages;
+        int * status;
+
+        thread_range(n, t, nth, &start, &end);
+        if (start == end)
+            continue;
+        first = (long)(plane + start) / page;
+        last = (long)(plane + end - 1) / page;
+        count = last - first + 1;
+        pages = (void **)malloc(count * sizeof(void *));
+        status = (int *)malloc(count * sizeof(int));
+        for (i = 0; i < count; i++)
+        {
+            pages[i] = (void *)((first + i) * page);
+        }
+
+        // With no target nodes move_pages only reports where the pages are
+        if (syscall(SYS_move_pages, 0, count, pages, NULL, status, 0) != 0)
+        {
+            printf("%s: cannot query page placement!\n", name);
+            free(pages);
+            free(status);
+            return;
+        }
+        for (i = 0; i < count; i++)
+        {
+            if (status[i] < 0)
+                missing++;
+            else if (status[i] == cpu_node[thread_cpu[t]])
+                local++;
+        }
+        npages += count;
+        free(pages);
+        free(status);
+    }
+
+    if (backend_size() > 1)
+        printf("Rank %d: ", backend_rank());
+    printf("%s: %ld of %ld pages on the node of their thread", name, local, npages);
+    if (missing > 0)
+        printf(", %ld not faulted in", missing);
+    printf("\n");
+}
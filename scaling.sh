@@ -0,0 +1,193 @@
+#!/bin/bash
+#
+# Strong and weak scaling sweep of the openmp (threads), mpi (ranks) and
+# hybrid (ranks of $HYBRID_THREADS threads, default 2) backends on one node.
+#
+# ./scaling.sh [--image DIR | --size MP] [--threads 1,2,4,8] [--ranks 1,2,4,8]
+#              [--reps N] [--backends openmp,mpi,hybrid (default all)] [--out DIR]
+#
+# Strong scaling runs the same image at every thread/rank count: in.pgm and
+# in.ppm from DIR, or synthetic images of MP megapixels (default 4). Weak
+# scaling runs synthetic images of MP x P megapixels at P threads/ranks,
+# where MP is the --image size when one is given. Every run keeps the
+# fastest of N repetitions (default 3) of the gray, HSL and YUV times the
+# program prints, and takes the per-stage times from the HIST_PROFILE report
+# of that repetition, so all backends are measured at the same points.
+#
+# Tables go to DIR/scaling.txt (default scaling) and the raw numbers to
+# DIR/scaling.csv and DIR/stages.csv. MPI runs use ${MPIRUN:-mpirun} with
+# $MPIRUN_FLAGS and one OpenMP thread per rank, or $HYBRID_THREADS for hybrid.
+
+set -e -o pipefail
+
+ROOT=$(cd "$(dirname "$0")" && pwd)
+IMAGE=""
+SIZE=4
+THREADS="1,2,4,8"
+RANKS="1,2,4,8"
+REPS=3
+BACKENDS="openmp,mpi,hybrid"
+OUT=scaling
+
+while [ $# -gt 0 ]; do
+    case "$1" in
+        --image) IMAGE=$(cd "$2" && pwd); shift 2 ;;
+        --size) SIZE=$2; shift 2 ;;
+        --threads) THREADS=$2; shift 2 ;;
+        --ranks) RANKS=$2; shift 2 ;;
+        --reps) REPS=$2; shift 2 ;;
+        --backends) BACKENDS=$2; shift 2 ;;
+        --out) OUT=$2; shift 2 ;;
+        *) echo "Usage: $0 [--image DIR | --size MP] [--threads N,...] [--ranks N,...] [--reps N] [--backends openmp,mpi] [--out DIR]"; exit 1 ;;
+    esac
+done
+
+mkdir -p "$OUT/bin" "$OUT/runs"
+OUT=$(cd "$OUT" && pwd)
+
+SOURCES="backend.cpp mpi-backend.cpp contrast-enhancement.cpp histogram-equalization.cpp histogram-kernels.cpp color-kernels.cpp image-io.cpp streaming.cpp batch.cpp packed-rgb.cpp image-arena.cpp clahe.cpp sequence.cpp profile.cpp perf-counters.cpp thread-placement.cpp"
+
+# One binary for both backends, with the MPI executor when mpicxx is there
+echo "Building..."
+case ",$BACKENDS," in
+    *,mpi,*|*,hybrid,*) CXX="mpicxx -DHIST_MPI" ;;
+    *) CXX=g++ ;;
+esac
+(cd "$ROOT/CPU" && $CXX -O2 -fopenmp -o "$OUT/bin/contrast" contrast.cpp $SOURCES &&
+                   g++ -O2 -fopenmp -o "$OUT/bin/benchmark" benchmark.cpp $SOURCES)
+
+# Megapixels of an in.pgm (first three header fields, no comments)
+image_mp() {
+    head -c 64 "$1/in.pgm" | tr -s ' \n\t\r' ' ' | awk '{ printf "%.6f", $2 * $3 / 1048576 }'
+}
+
+# Input directory for a scaling mode and count: the given or a synthetic
+# image for strong scaling, a synthetic one of SIZE x P megapixels for weak
+input_dir() {
+    local mode=$1 p=$2 dir
+    if [ "$mode" = strong ]; then
+        if [ -n "$IMAGE" ]; then
+            echo "$IMAGE"
+            return
+        fi
+        dir="$OUT/inputs/strong"
+        mp=$SIZE
+    else
+        dir="$OUT/inputs/weak_$p"
+        mp=$(awk -v s="$SIZE" -v p="$p" 'BEGIN { printf "%.6f", s * p }')
+    fi
+    if [ ! -f "$dir/in.ppm" ]; then
+        mkdir -p "$dir"
+        "$OUT/bin/benchmark" --emit "$dir" --sizes "$mp" >/dev/null
+    fi
+    echo "$dir"
+}
+
+# Gray, HSL and YUV times (ms) printed by one run
+pipeline_times() {
+    awk '/^Processing time:/ { g = $(NF - 1) }
+         /^HSL processing time:/ { h = $(NF - 1) }
+         /^YUV processing time:/ { y = $(NF - 1) }
+         END { print g, h, y }' "$1"
+}
+
+# "stage time_ms" per line of a HIST_PROFILE report
+stage_times() {
+    sed -n 's/.*"name": "\([a-z]*\)", "time_ms": \([0-9.]*\),.*/\1 \2/p' "$1"
+}
+
+# Run one backend at count p on the images in dir, REPS times, and keep the
+# fastest repetition
+run_case() {
+    local backend=$1 mode=$2 p=$3 dir=$4
+    local run="$OUT/runs/${backend}_${mode}_$p" best="" r
+    mkdir -p "$run"
+    cp "$dir/in.pgm" "$dir/in.ppm" "$run/"
+
+    for r in $(seq 1 "$REPS"); do
+        if [ "$backend" = openmp ]; then
+            (cd "$run" && OMP_NUM_THREADS=$p HIST_PROFILE=prof_$r.json "$OUT/bin/contrast" --backend openmp > log_$r.txt 2>&1)
+        else
+            [ "$backend" = hybrid ] && threads=${HYBRID_THREADS:-2} || threads=1
+            (cd "$run" && OMP_NUM_THREADS=$threads HIST_PROFILE=prof_$r.json \
+                ${MPIRUN:-mpirun} $MPIRUN_FLAGS -np "$p" "$OUT/bin/contrast" --backend "$backend" > log_$r.txt 2>&1)
+        fi
+        set -- $(pipeline_times "$run/log_$r.txt")
+        total=$(awk -v g="$1" -v h="$2" -v y="$3" 'BEGIN { print g + h + y }')
+        if [ -z "$best" ] || awk -v a="$total" -v b="$best_total" 'BEGIN { exit !(a < b) }'; then
+            best=$r
+            best_total=$total
+            best_times="$1 $2 $3"
+        fi
+    done
+
+    set -- $best_times
+    echo "$backend,$mode,$p,gray,$1" >> "$OUT/raw.csv"
+    echo "$backend,$mode,$p,hsl,$2" >> "$OUT/raw.csv"
+    echo "$backend,$mode,$p,yuv,$3" >> "$OUT/raw.csv"
+    stage_times "$run/prof_$best.json" | while read stage t; do
+        echo "$backend,$mode,$p,$stage,$t" >> "$OUT/stages.csv"
+    done
+}
+
+rm -f "$OUT/raw.csv"
+echo "backend,scaling,count,stage,time_ms" > "$OUT/stages.csv"
+if [ -n "$IMAGE" ]; then
+    SIZE=$(image_mp "$IMAGE")
+fi
+
+for backend in $(echo "$BACKENDS" | tr ',' ' '); do
+    if [ "$backend" = openmp ]; then counts=$THREADS; else counts=$RANKS; fi
+    for mode in strong weak; do
+        for p in $(echo "$counts" | tr ',' ' '); do
+            echo "$backend $mode scaling, $p $([ "$backend" = openmp ] && echo threads || echo ranks)..."
+            run_case "$backend" "$mode" "$p" "$(input_dir "$mode" "$p")"
+        done
+    done
+done
+
+# Speedup and efficiency against the smallest count of each series: strong
+# speedup is T1 / Tp and efficiency speedup / p; weak efficiency is T1 / Tp
+echo "backend,scaling,count,pipeline,time_ms,speedup,efficiency" > "$OUT/scaling.csv"
+awk -F, '
+{
+    key = $1 "," $2 "," $4
+    if (!(key in base_p) || $3 < base_p[key]) { base_p[key] = $3; base_t[key] = $5 }
+    rows[NR] = $0
+}
+END {
+    for (i = 1; i <= NR; i++) {
+        split(rows[i], f, ",")
+        key = f[1] "," f[2] "," f[4]
+        ratio = (f[5] > 0) ? base_t[key] / f[5] : 0
+        if (f[2] == "strong") {
+            speedup = ratio * base_p[key]
+            eff = speedup / f[3]
+        } else {
+            speedup = ratio * f[3] / base_p[key]
+            eff = ratio
+        }
+        printf "%s,%.3f,%.3f\n", rows[i], speedup, eff
+    }
+}' "$OUT/raw.csv" >> "$OUT/scaling.csv"
+rm -f "$OUT/raw.csv"
+
+{
+    echo "Scaling on $(hostname), $(nproc) CPUs, base size $SIZE MP, best of $REPS"
+    for backend in $(echo "$BACKENDS" | tr ',' ' '); do
+        for mode in strong weak; do
+            echo
+            echo "$backend $mode scaling"
+            printf "%-6s %-8s %12s %9s %11s\n" count pipeline "time(ms)" speedup efficiency
+            awk -F, -v b="$backend" -v m="$mode" '$1 == b && $2 == m {
+                printf "%-6s %-8s %12.3f %9.2f %11.2f\n", $3, $4, $5, $6, $7 }' "$OUT/scaling.csv"
+            echo
+            printf "%-6s" count
+            awk -F, -v b="$backend" -v m="$mode" '$1 == b && $2 == m && !seen[$4]++ { printf " %11s", $4 }' "$OUT/stages.csv"
+            echo "  (stage ms, slowest thread/rank)"
+            awk -F, -v b="$backend" -v m="$mode" '$1 == b && $2 == m {
+                if ($3 != last) { if (last != "") printf "\n"; printf "%-6s", $3; last = $3 }
+                printf " %11.3f", $5 } END { if (last != "") printf "\n" }' "$OUT/stages.csv"
+        done
+    done
+} | tee "$OUT/scaling.txt"